@@ -1,17 +1,33 @@
 #include "client.hpp"
 #include "utils/token.hpp"
+#include "utils/shared_memory_transport.hpp"
 #include "config.hpp"
+#include <ixwebsocket/IXWebSocket.h>
 #include <nlohmann/json.hpp>
+#include <fstream>
+#include <sstream>
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <random>
+#include <algorithm>
 
 using json = nlohmann::json;
 
 namespace GameAway {
 
+namespace {
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+    
+} // namespace
+
 Client::Client() {
     m_inputHook = std::make_unique<InputHook>();
+    m_gamepad = std::make_unique<GamepadCapture>();
 }
 
 Client::~Client() {
@@ -28,6 +44,16 @@ void Client::sendStatus(const std::string& status) {
     }
 }
 
+void Client::setChangeCallback(ChangeCallback callback) {
+    m_changeCallback = std::move(callback);
+}
+
+void Client::notifyChange() {
+    if (m_changeCallback) {
+        m_changeCallback();
+    }
+}
+
 bool Client::connect(const std::string& serverIp, uint16_t port, const std::string& token) {
     m_token = token;
     m_crypto = std::make_unique<Crypto>(token);
@@ -37,134 +63,787 @@ bool Client::connect(const std::string& serverIp, uint16_t port, const std::stri
         return false;
     }
     
-    std::string url = "ws://" + serverIp + ":" + std::to_string(port);
+    if (m_useRelay) {
+        m_pairingId = getPairingId(token);
+    }
+    
+    // Text frames are sized so the active transport takes them whole
+    m_maxFrameBytes = TEXT_FRAME_BYTES;
+    if (m_useRelay) {
+        m_maxFrameBytes = std::min(m_maxFrameBytes, RELAY_MAX_FRAME_BYTES);
+    }
+    
+    if (serverIp == LOCAL_ADDRESS) {
+        m_transport = std::make_unique<SharedMemoryTransport>(SharedMemoryTransport::Role::Client, port);
+    } else {
+        auto webSocket = std::make_shared<ix::WebSocket>();
+        webSocket->setUrl("ws://" + serverIp + ":" + std::to_string(port));
+        
+        // Reconnects are driven by reconnectLoop so they can resume the session
+        webSocket->disableAutomaticReconnection();
+        
+        // Lets the relay tell this socket is alive before the server answers
+        if (m_useRelay) {
+            webSocket->setPingInterval(RELAY_PING_INTERVAL_S);
+        }
+        
+        m_transport = std::make_unique<WebSocketTransport>(webSocket);
+    }
+    
+    if (m_impairment) {
+        auto impaired = std::make_unique<ImpairedTransport>(std::move(m_transport), *m_impairment);
+        m_impaired = impaired.get();
+        m_transport = std::move(impaired);
+        sendStatus("Simulating network: " + m_impairment->describe());
+    }
+    
+    m_stopping.store(false);
+    m_handshakeDone.store(false);
+    m_handshakeResult.store(false);
+    
+    m_transport->setEventCallback([this](TransportEvent event, const std::string& data) {
+        onTransportEvent(event, data);
+    });
+    
+    m_transport->start();
+    
+    // Wait for the handshake to finish (accept, reject or socket failure)
+    bool done;
+    {
+        std::unique_lock<std::mutex> lock(m_stateMutex);
+        done = m_stateCv.wait_for(lock, std::chrono::milliseconds(CONNECTION_TIMEOUT_MS),
+            [this] { return m_handshakeDone.load(); });
+    }
+    
+    if (!done) {
+        sendStatus("Connection timeout");
+        m_transport->stop();
+        return false;
+    }
+    
+    if (m_handshakeResult.load() && !m_reconnectThread.joinable()) {
+        {
+            // A previous disconnect() left the sender stopped
+            std::lock_guard<std::mutex> lock(m_sendMutex);
+            m_sendStopping = false;
+        }
+        m_reconnectThread = std::thread(&Client::reconnectLoop, this);
+        m_sendThread = std::thread(&Client::sendLoop, this);
+    }
     
-    m_webSocket = std::make_unique<ix::WebSocket>();
-    m_webSocket->setUrl(url);
+    // Keep the server's coordinate mapping in step with our monitors
+    if (m_handshakeResult.load()) {
+        refreshDesktop();
+        m_displayWatcher.start([this]() {
+            refreshDesktop();
+            if (m_connected.load()) sendLayout();
+        });
+    }
     
-    std::atomic<bool> connectionResult{false};
-    std::atomic<bool> connectionDone{false};
+    return m_handshakeResult.load();
+}
+
+bool Client::loadImpairment(const std::string& path, std::string& error) {
+    std::ifstream file(path);
+    if (!file) return true;
     
-    m_webSocket->setOnMessageCallback([this, &connectionResult, &connectionDone](const ix::WebSocketMessagePtr& msg) {
-        if (msg->type == ix::WebSocketMessageType::Open) {
-            sendStatus("Connected, sending authentication...");
+    std::stringstream text;
+    text << file.rdbuf();
+    
+    ImpairmentProfile profile;
+    if (!ImpairmentProfile::parse(text.str(), profile, error)) return false;
+    
+    m_impairment = profile;
+    return true;
+}
+
+std::string Client::getImpairmentSummary() const {
+    return m_impaired ? m_impaired->summary() : std::string();
+}
+
+void Client::onTransportEvent(TransportEvent event, const std::string& data) {
+    if (event == TransportEvent::Open) {
+        // The relay reads this one frame to find our server; the rest pass through
+        if (m_useRelay) {
+            json pair;
+            pair["type"] = MsgType::PAIR;
+            pair["id"] = m_pairingId;
+            pair["role"] = "peer";
+            m_transport->send(pair.dump());
+        }
+        
+        sendHandshake(std::string());
+    }
+    else if (event == TransportEvent::Message) {
+        m_lastReceivedMs.store(steadyNowMs());
+        
+        try {
+            json j = json::parse(data);
+            std::string type = j["type"].get<std::string>();
             
-            // Send encrypted connection request
-            json connectData;
-            connectData["pcName"] = getPcName();
+            if (type == MsgType::CHALLENGE) {
+                // Direct servers want their cookie back before reading CONNECT
+                sendHandshake(j.value("c", ""));
+            }
+            else if (type == MsgType::ACCEPT) {
+                onAccept(j.value("d", ""));
+            }
+            else if (type == MsgType::REJECT) {
+                sendStatus("Connection rejected by server");
+                finishHandshake(false);
+            }
+        } catch (...) {
+            // Ignore parse errors
+        }
+    }
+    else if (event == TransportEvent::Close) {
+        if (m_connected.load()) {
+            onConnectionLost();
+        } else {
+            finishHandshake(false);
+        }
+    }
+    else if (event == TransportEvent::Error) {
+        sendStatus("Connection error: " + data);
+        if (m_connected.load()) {
+            onConnectionLost();
+        } else {
+            finishHandshake(false);
+        }
+    }
+}
+
+void Client::sendHandshake(const std::string& cookie) {
+    std::string ticket;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionMutex);
+        ticket = m_sessionTicket;
+    }
+    
+    json connectData;
+    connectData["pcName"] = getPcName();
+    connectData["id"] = getClientId();
+    
+    // The server repeats held keys itself, at this keyboard's settings
+    KeyRepeatTiming repeat = queryKeyRepeatTiming();
+    connectData["kr"] = {repeat.delayMs, repeat.intervalMs};
+    
+    json request;
+    if (ticket.empty()) {
+        if (cookie.empty()) sendStatus("Connected, sending authentication...");
+        request["type"] = MsgType::CONNECT;
+    } else {
+        // Resume with the cached ticket: no key derivation, no approval prompt
+        if (cookie.empty()) sendStatus("Reconnected, resuming session...");
+        connectData["ticket"] = ticket;
+        request["type"] = MsgType::REATTACH;
+    }
+    request["d"] = m_crypto->encrypt(connectData.dump());
+    if (!cookie.empty()) {
+        request["c"] = cookie;
+    }
+    
+    m_transport->send(request.dump());
+}
+
+void Client::onAccept(const std::string& encryptedData) {
+    bool resumed = false;
+    uint64_t ackedSeq = 0;
+    
+    std::string decrypted = encryptedData.empty() ? "" : m_crypto->decrypt(encryptedData);
+    if (!decrypted.empty()) {
+        try {
+            json session = json::parse(decrypted);
+            resumed = session.value("resumed", false);
+            ackedSeq = session.value("ack", 0ULL);
             
-            std::string encrypted = m_crypto->encrypt(connectData.dump());
+            std::lock_guard<std::mutex> lock(m_sessionMutex);
+            m_sessionTicket = session.value("ticket", "");
+        } catch (...) {
+            // Server did not issue a ticket; reconnects will need a full handshake
+        }
+    }
+    
+    if (resumed) {
+        // Queue the missed events before anything newer can be sent
+        replayPending(ackedSeq);
+    } else {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_priorityLane.clear();
+        m_pendingMove.reset();
+        m_pendingAxes.reset();
+    }
+    
+    m_lastReceivedMs.store(steadyNowMs());
+    m_connected.store(true);
+    m_sendCv.notify_all();
+    sendLayout();
+    
+    if (resumed) {
+        // Stick positions from the outage were dropped; send the current ones
+        m_gamepad->resync();
+        m_reconnects.fetch_add(1);
+        sendStatus("Session resumed");
+        notifyChange();
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_retransmitMutex);
+            m_retransmitBuffer.clear();
+        }
+        sendStatus("Connection accepted! Starting input capture...");
+        
+        // Start input hook (no-op if it kept running across a reconnect)
+        m_inputHook->start([this](const InputEvent& event) {
+            onInputEvent(event);
+        });
+        if (GAMEPAD_ENABLED) {
+            m_gamepad->start([this](const InputEvent& event) {
+                onInputEvent(event);
+            });
+        }
+    }
+    
+    finishHandshake(true);
+}
+
+void Client::onConnectionLost() {
+    bool hasTicket;
+    {
+        std::lock_guard<std::mutex> lock(m_sessionMutex);
+        hasTicket = !m_sessionTicket.empty();
+    }
+    
+    releaseRemoteFocus();
+    
+    if (m_stopping.load() || !hasTicket) {
+        m_connected.store(false);
+        m_inputHook->stop();
+        m_gamepad->stop();
+        sendStatus("Disconnected from server");
+        notifyChange();
+        return;
+    }
+    
+    // Flag the reconnect before clearing m_connected so the main loop never sees neither
+    bool alreadyReconnecting = m_reconnecting.exchange(true);
+    m_connected.store(false);
+    
+    // Keep the hook running so key/button edges are buffered during the outage
+    if (!alreadyReconnecting) {
+        sendStatus("Connection lost, reconnecting...");
+        notifyChange();
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_reconnectRequested = true;
+        m_stateCv.notify_all();
+    } else {
+        finishHandshake(false);
+    }
+}
+
+void Client::finishHandshake(bool result) {
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_handshakeResult.store(result);
+        m_handshakeDone.store(true);
+    }
+    m_stateCv.notify_all();
+}
+
+void Client::reconnectLoop() {
+    std::mt19937 rng(std::random_device{}());
+    std::unique_lock<std::mutex> lock(m_stateMutex);
+    
+    while (!m_stopping.load()) {
+        m_stateCv.wait(lock, [this] { return m_stopping.load() || m_reconnectRequested; });
+        if (m_stopping.load()) break;
+        m_reconnectRequested = false;
+        
+        bool resumed = false;
+        for (int attempt = 0; attempt < RECONNECT_MAX_ATTEMPTS && !m_stopping.load(); ++attempt) {
+            // Exponential backoff with jitter so a flapping link does not sync retries
+            int delay = std::min(RECONNECT_MAX_DELAY_MS, RECONNECT_BASE_DELAY_MS << std::min(attempt, 16));
+            std::uniform_int_distribution<int> jitter(delay / 2, delay);
+            auto wait = std::chrono::milliseconds(jitter(rng));
             
-            json request;
-            request["type"] = MsgType::CONNECT;
-            request["d"] = encrypted;
+            if (m_stateCv.wait_for(lock, wait, [this] { return m_stopping.load(); })) break;
             
-            m_webSocket->send(request.dump());
-        }
-        else if (msg->type == ix::WebSocketMessageType::Message) {
-            try {
-                json j = json::parse(msg->str);
-                std::string type = j["type"].get<std::string>();
-                
-                if (type == MsgType::ACCEPT) {
-                    m_connected.store(true);
-                    connectionResult.store(true);
-                    connectionDone.store(true);
-                    sendStatus("Connection accepted! Starting input capture...");
-                    
-                    // Start input hook
-                    m_inputHook->start([this](const InputEvent& event) {
-                        onInputEvent(event);
-                    });
-                }
-                else if (type == MsgType::REJECT) {
-                    sendStatus("Connection rejected by server");
-                    connectionResult.store(false);
-                    connectionDone.store(true);
-                }
-            } catch (...) {
-                // Ignore parse errors
+            // Stop first: a link given up on by checkHeartbeat() reports its
+            // Close now, and that must not count as this attempt failing
+            lock.unlock();
+            m_transport->stop();
+            m_handshakeDone.store(false);
+            m_transport->start();
+            lock.lock();
+            
+            m_stateCv.wait_for(lock, std::chrono::milliseconds(CONNECTION_TIMEOUT_MS),
+                [this] { return m_stopping.load() || m_handshakeDone.load(); });
+            
+            if (m_handshakeResult.load() && m_connected.load()) {
+                resumed = true;
+                break;
             }
         }
-        else if (msg->type == ix::WebSocketMessageType::Close) {
-            m_connected.store(false);
+        
+        m_reconnecting.store(false);
+        
+        if (!resumed && !m_stopping.load()) {
+            lock.unlock();
+            releaseRemoteFocus();
             m_inputHook->stop();
-            sendStatus("Disconnected from server");
-            connectionDone.store(true);
+            m_gamepad->stop();
+            sendStatus("Reconnect failed, giving up");
+            notifyChange();
+            lock.lock();
         }
-        else if (msg->type == ix::WebSocketMessageType::Error) {
-            sendStatus("Connection error: " + msg->errorInfo.reason);
-            connectionDone.store(true);
-        }
-    });
+    }
+}
+
+void Client::checkHeartbeat() {
+    if (!m_connected.load()) return;
     
-    m_webSocket->start();
+    int64_t now = steadyNowMs();
     
-    // Wait for connection result with timeout
-    int timeout = CONNECTION_TIMEOUT_MS / 100;
-    while (!connectionDone.load() && timeout > 0) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        timeout--;
+    // A dropped Wi-Fi link only closes the socket at the TCP timeout
+    if (now - m_lastReceivedMs.load() > HEARTBEAT_INTERVAL_MS * HEARTBEAT_MISSES) {
+        sendStatus("Server stopped responding");
+        onConnectionLost();
+        return;
     }
     
-    if (!connectionDone.load()) {
-        sendStatus("Connection timeout");
-        m_webSocket->stop();
-        return false;
+    // Input frames already tell the server we are here
+    if (now - m_lastSentMs.load() >= HEARTBEAT_INTERVAL_MS) {
+        json heartbeat;
+        heartbeat["type"] = MsgType::HEARTBEAT;
+        m_transport->send(heartbeat.dump());
+        m_lastSentMs.store(now);
     }
-    
-    return connectionResult.load();
 }
 
 void Client::disconnect() {
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_stopping.store(true);
+    }
+    m_stateCv.notify_all();
+    
+    if (m_reconnectThread.joinable()) {
+        m_reconnectThread.join();
+    }
+    
+    m_displayWatcher.stop();
     m_inputHook->stop();
+    m_gamepad->stop();
+    stopSender();
     
-    if (m_webSocket) {
-        m_webSocket->stop();
-        m_webSocket.reset();
+    if (m_transport) {
+        m_transport->stop();
+        m_impaired = nullptr;
+        m_transport.reset();
     }
     
     m_connected.store(false);
+    m_reconnecting.store(false);
 }
 
 void Client::pause() {
-    m_paused.store(true);
+    // Capture first: it reports releases for held input, which must still go out
+    m_gamepad->releaseHeld();
     m_inputHook->pause();
+    m_paused.store(true);
     
-    if (m_webSocket && m_connected.load()) {
+    if (m_transport && m_connected.load()) {
         json msg;
         msg["type"] = MsgType::PAUSE;
-        m_webSocket->send(msg.dump());
+        enqueueControl(msg.dump());
     }
 }
 
 void Client::resume() {
     m_paused.store(false);
     m_inputHook->resume();
+    m_gamepad->resync();
     
-    if (m_webSocket && m_connected.load()) {
+    if (m_transport && m_connected.load()) {
         json msg;
         msg["type"] = MsgType::RESUME;
-        m_webSocket->send(msg.dump());
+        enqueueControl(msg.dump());
+    }
+}
+
+void Client::setFocus(InputFocus focus) {
+    std::lock_guard<std::mutex> lock(m_focusMutex);
+    applyFocus(focus);
+}
+
+void Client::applyFocus(InputFocus focus) {
+    InputFocus previous = m_focus.load();
+    if (previous == focus) return;
+    
+    // Releases go out while the server still has focus
+    if (previous != InputFocus::Local && focus == InputFocus::Local) {
+        m_inputHook->releaseHeld();
+        m_gamepad->releaseHeld();
+    }
+    
+    m_focus.store(focus);
+    if (previous == InputFocus::Local) {
+        m_gamepad->resync();
+    }
+    m_inputHook->setSuppressLocal(focus == InputFocus::Remote && ROUTING_SUPPRESS_LOCAL);
+    
+    sendStatus(focus == InputFocus::Remote ? "Input focus: server" :
+               focus == InputFocus::Local ? "Input focus: this PC" : "Input focus: both");
+}
+
+void Client::toggleFocus() {
+    std::lock_guard<std::mutex> lock(m_focusMutex);
+    applyFocus(m_focus.load() == InputFocus::Remote ? InputFocus::Local : InputFocus::Remote);
+}
+
+void Client::releaseRemoteFocus() {
+    // Local input must not stay swallowed while the server cannot get it
+    std::lock_guard<std::mutex> lock(m_focusMutex);
+    if (m_focus.load() == InputFocus::Remote) {
+        applyFocus(InputFocus::Local);
+    }
+}
+
+void Client::refreshDesktop() {
+    MonitorRect desktop = boundingRect(queryMonitorLayout());
+    
+    std::lock_guard<std::mutex> lock(m_desktopMutex);
+    m_desktop = desktop;
+}
+
+bool Client::crossEdge(const InputEvent& move) {
+    // Held across the check and the switch so a hotkey toggle cannot land in between
+    std::lock_guard<std::mutex> focusLock(m_focusMutex);
+    InputFocus focus = m_focus.load();
+    if (ROUTING_SERVER_EDGE == ScreenEdge::None || focus == InputFocus::Mirror) return false;
+    
+    MonitorRect desk;
+    {
+        std::lock_guard<std::mutex> lock(m_desktopMutex);
+        desk = m_desktop;
+    }
+    if (desk.width <= 0 || desk.height <= 0) return false;
+    
+    int right = desk.left + desk.width - 1;
+    int bottom = desk.top + desk.height - 1;
+    
+    // Reaching the server's edge enters it, the opposite edge comes back;
+    // the cursor is moved across so it continues from the other side
+    bool toServer = focus == InputFocus::Local;
+    int x = move.x;
+    int y = move.y;
+    
+    switch (ROUTING_SERVER_EDGE) {
+        case ScreenEdge::Left:
+            if (toServer ? x > desk.left : x < right) return false;
+            x = toServer ? right - ROUTING_WARP_MARGIN : desk.left + ROUTING_WARP_MARGIN;
+            break;
+        case ScreenEdge::Right:
+            if (toServer ? x < right : x > desk.left) return false;
+            x = toServer ? desk.left + ROUTING_WARP_MARGIN : right - ROUTING_WARP_MARGIN;
+            break;
+        case ScreenEdge::Top:
+            if (toServer ? y > desk.top : y < bottom) return false;
+            y = toServer ? bottom - ROUTING_WARP_MARGIN : desk.top + ROUTING_WARP_MARGIN;
+            break;
+        case ScreenEdge::Bottom:
+            if (toServer ? y < bottom : y > desk.top) return false;
+            y = toServer ? desk.top + ROUTING_WARP_MARGIN : bottom - ROUTING_WARP_MARGIN;
+            break;
+        default:
+            return false;
+    }
+    
+    applyFocus(toServer ? InputFocus::Remote : InputFocus::Local);
+    m_inputHook->warpCursor(x, y);
+    return true;
+}
+
+bool Client::sendText(const std::string& text) {
+    if (!m_transport || !m_connected.load() || m_paused.load()) return false;
+    if (text.empty() || text.size() > TEXT_MAX_BYTES) return false;
+    
+    auto isContinuation = [&text](size_t i) {
+        return i < text.size() && (static_cast<unsigned char>(text[i]) & 0xC0) == 0x80;
+    };
+    
+    // Frames are built first and queued only once all fit, so a paste is sent whole or not at all
+    std::vector<std::string> frames;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // JSON escaping, the nonce and tag, and base64 grow a chunk by a
+        // factor that depends on its content, so start from the raw budget
+        // and shrink until the frame as sent fits
+        size_t length = std::min(text.size() - pos, m_maxFrameBytes);
+        std::string frame;
+        for (;;) {
+            // Split between UTF-8 sequences, never inside one
+            size_t end = pos + length;
+            while (end > pos && isContinuation(end)) --end;
+            if (end == pos) {
+                end = pos + 1;
+                while (isContinuation(end)) ++end;
+            }
+            
+            // Nor inside a CRLF: typed apart, its halves would be two Enters
+            if (end < text.size() && text[end - 1] == '\r' && text[end] == '\n') {
+                if (end - pos == 1) {
+                    ++end;
+                } else {
+                    --end;
+                }
+            }
+            
+            json payload;
+            payload["s"] = text.substr(pos, end - pos);
+            
+            json msg;
+            msg["type"] = MsgType::TEXT;
+            msg["d"] = m_crypto->encrypt(payload.dump());
+            frame = msg.dump();
+            
+            if (frame.size() <= m_maxFrameBytes) {
+                pos = end;
+                break;
+            }
+            
+            // One character that does not fit cannot be split further
+            if (end - pos <= 4) return false;
+            length = std::min(end - pos - 1, (end - pos) * m_maxFrameBytes / frame.size());
+        }
+        frames.push_back(std::move(frame));
+    }
+    
+    for (const auto& frame : frames) {
+        enqueueControl(frame);
+    }
+    return true;
+}
+
+void Client::onInputEvent(const InputEvent& captured) {
+    if (m_paused.load()) return;
+    
+    // Rules see every event, whatever has focus, so modifier state stays right
+    InputEvent event = captured;
+    if (!m_filter.apply(event)) return;
+    
+    if (event.type == InputEventType::MouseMove && crossEdge(event)) return;
+    
+    // Nothing is serialized or encrypted while this PC has focus
+    if (m_focus.load() == InputFocus::Local) return;
+    
+    bool isMove = event.type == InputEventType::MouseMove;
+    bool isAxes = event.type == InputEventType::GamepadAxes;
+    PackedInputEvent packed = packInputEvent(event);
+    
+    // The hook and gamepad threads both get here; numbering and queueing
+    // under one lock keeps each lane in seq order, which the server's
+    // duplicate check relies on
+    {
+        std::lock_guard<std::mutex> lock(m_retransmitMutex);
+        uint64_t seq = m_nextSeq.fetch_add(1);
+        
+        // Key and button edges must survive a dropped link; moves and axes are stale by then
+        if (!isMove && !isAxes) {
+            m_retransmitBuffer.push_back({seq, packed});
+            if (m_retransmitBuffer.size() > RETRANSMIT_BUFFER_SIZE) {
+                m_retransmitBuffer.pop_front();
+            }
+        }
+        
+        if (!m_connected.load()) return;
+        
+        // Hand off to the sender thread; the hook thread never encrypts or blocks
+        std::lock_guard<std::mutex> sendLock(m_sendMutex);
+        if (isMove) {
+            m_pendingMove = PendingEvent{seq, packed};
+        } else if (isAxes) {
+            m_pendingAxes = PendingEvent{seq, packed};
+        } else {
+            m_priorityLane.push_back({seq, packed, {}});
+        }
+    }
+    m_sendCv.notify_one();
+}
+
+void Client::enqueueControl(const std::string& message) {
+    // Same lane as discrete events so e.g. PAUSE never overtakes the releases before it
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_priorityLane.push_back({0, PackedInputEvent{}, message});
     }
+    m_sendCv.notify_one();
 }
 
-void Client::onInputEvent(const InputEvent& event) {
-    if (!m_connected.load() || m_paused.load()) return;
+void Client::sendLoop() {
+    std::unique_lock<std::mutex> lock(m_sendMutex);
     
-    std::string serialized = serializeInputEvent(event);
+    while (!m_sendStopping) {
+        // Wake at least once per heartbeat interval, busy or not
+        bool ready = m_sendCv.wait_for(lock, std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS), [this] {
+            return m_sendStopping ||
+                (m_connected.load() && (!m_priorityLane.empty() || m_pendingMove || m_pendingAxes));
+        });
+        if (m_sendStopping) break;
+        
+        lock.unlock();
+        checkHeartbeat();
+        lock.lock();
+        if (!ready) continue;
+        
+        // Discrete lane: always drained, whatever the socket backlog
+        while (!m_priorityLane.empty() && m_connected.load()) {
+            OutgoingFrame frame = std::move(m_priorityLane.front());
+            m_priorityLane.pop_front();
+            
+            // A click must not arrive before the move that positioned it,
+            // nor a gamepad button before the stick movement preceding it
+            std::optional<PendingEvent> move;
+            auto type = static_cast<InputEventType>(frame.event.type);
+            bool positional = type == InputEventType::MouseButtonDown ||
+                              type == InputEventType::MouseButtonUp ||
+                              type == InputEventType::MouseWheel;
+            if (frame.seq != 0 && positional && m_pendingMove && m_pendingMove->seq < frame.seq) {
+                move.swap(m_pendingMove);
+            }
+            bool gamepad = type == InputEventType::GamepadButtons;
+            if (frame.seq != 0 && gamepad && m_pendingAxes && m_pendingAxes->seq < frame.seq) {
+                move.swap(m_pendingAxes);
+            }
+            
+            lock.unlock();
+            if (move) {
+                sendInputEvent(move->event, move->seq);
+            }
+            bool sent;
+            if (frame.seq == 0) {
+                sent = m_transport->send(frame.control);
+                if (sent) m_lastSentMs.store(steadyNowMs());
+            } else {
+                sent = sendInputEvent(frame.event, frame.seq);
+            }
+            lock.lock();
+            
+            // The transport had no room (e.g. a full shared memory ring):
+            // keep the frame first in line and retry once it drains. If the
+            // link is down instead, events are in the retransmit buffer.
+            if (!sent && m_connected.load()) {
+                m_priorityLane.push_front(std::move(frame));
+                m_sendCv.wait_for(lock, std::chrono::milliseconds(SEND_CONGESTION_POLL_MS),
+                    [this] { return m_sendStopping; });
+                if (m_sendStopping) break;
+            }
+        }
+        
+        // Move and axis lanes: only while the link keeps up; until then
+        // newer values just overwrite the pending ones
+        if ((m_pendingMove || m_pendingAxes) && m_connected.load()) {
+            if (m_transport->bufferedAmount() < SEND_BUFFER_HIGH_WATER) {
+                std::optional<PendingEvent> move;
+                std::optional<PendingEvent> axes;
+                move.swap(m_pendingMove);
+                axes.swap(m_pendingAxes);
+                
+                lock.unlock();
+                if (move) {
+                    sendInputEvent(move->event, move->seq);
+                }
+                if (axes) {
+                    sendInputEvent(axes->event, axes->seq);
+                }
+                lock.lock();
+            } else {
+                m_sendCv.wait_for(lock, std::chrono::milliseconds(SEND_CONGESTION_POLL_MS),
+                    [this] { return m_sendStopping || !m_priorityLane.empty(); });
+            }
+        }
+    }
+}
+
+void Client::stopSender() {
+    {
+        std::lock_guard<std::mutex> lock(m_sendMutex);
+        m_sendStopping = true;
+    }
+    m_sendCv.notify_all();
+    
+    if (m_sendThread.joinable()) {
+        m_sendThread.join();
+    }
+}
+
+bool Client::sendInputEvent(const PackedInputEvent& packed, uint64_t seq) {
+    // Queued events are at most seconds old, well within the unpacking range
+    uint64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    InputEvent event = unpackInputEvent(packed, nowMs);
+    
+    std::string serialized = serializeInputEvent(event, seq);
     std::string encrypted = m_crypto->encrypt(serialized);
     
     json msg;
-    msg["type"] = (event.type == InputEventType::KeyDown || event.type == InputEventType::KeyUp) 
-        ? MsgType::KEY : MsgType::MOUSE;
+    switch (event.type) {
+        case InputEventType::KeyDown:
+        case InputEventType::KeyUp:
+            msg["type"] = MsgType::KEY;
+            break;
+        case InputEventType::GamepadButtons:
+        case InputEventType::GamepadAxes:
+            msg["type"] = MsgType::GAMEPAD;
+            break;
+        default:
+            msg["type"] = MsgType::MOUSE;
+            break;
+    }
     msg["d"] = encrypted;
     
-    m_webSocket->send(msg.dump());
+    if (!m_transport->send(msg.dump())) return false;
+    m_lastSentMs.store(steadyNowMs());
     m_eventsSent.fetch_add(1);
+    notifyChange();
+    return true;
 }
 
-std::string Client::serializeInputEvent(const InputEvent& event) {
+void Client::replayPending(uint64_t ackedSeq) {
+    std::lock_guard<std::mutex> lock(m_retransmitMutex);
+    
+    // Drop what the server already has, resend the rest in order
+    while (!m_retransmitBuffer.empty() && m_retransmitBuffer.front().seq <= ackedSeq) {
+        m_retransmitBuffer.pop_front();
+    }
+    
+    // The lane may still hold frames from before the drop; the retransmit
+    // buffer already covers its events, and stale moves are worthless
+    std::lock_guard<std::mutex> sendLock(m_sendMutex);
+    m_priorityLane.clear();
+    m_pendingMove.reset();
+    m_pendingAxes.reset();
+    for (const auto& pending : m_retransmitBuffer) {
+        m_priorityLane.push_back({pending.seq, pending.event, {}});
+    }
+}
+
+void Client::sendLayout() {
+    json monitors = json::array();
+    for (const auto& m : queryMonitorLayout()) {
+        monitors.push_back({m.left, m.top, m.width, m.height});
+    }
+    
+    json layout;
+    layout["m"] = monitors;
+    
+    json msg;
+    msg["type"] = MsgType::LAYOUT;
+    msg["d"] = m_crypto->encrypt(layout.dump());
+    
+    m_transport->send(msg.dump());
+}
+
+std::string Client::serializeInputEvent(const InputEvent& event, uint64_t seq) {
     json j;
     j["t"] = static_cast<int>(event.type);
     j["vk"] = event.vkCode;
@@ -173,8 +852,13 @@ std::string Client::serializeInputEvent(const InputEvent& event) {
     j["y"] = event.y;
     j["btn"] = event.button;
     j["wd"] = event.wheelDelta;
+    if (event.type == InputEventType::GamepadButtons || event.type == InputEventType::GamepadAxes) {
+        const GamepadState& gp = event.gamepad;
+        j["gp"] = {gp.buttons, gp.leftTrigger, gp.rightTrigger, gp.thumbLX, gp.thumbLY, gp.thumbRX, gp.thumbRY};
+    }
     j["ts"] = event.timestamp;
+    j["sq"] = seq;
     return j.dump();
 }
-
+    
 } // namespace GameAway
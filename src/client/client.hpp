@@ -1,55 +1,195 @@
 #pragma once
 
 #include "input_hook.hpp"
+#include "gamepad_capture.hpp"
 #include "utils/crypto.hpp"
-#include <ixwebsocket/IXWebSocket.h>
+#include "utils/impaired_transport.hpp"
+#include "utils/input_filter.hpp"
+#include "utils/monitor_layout.hpp"
+#include "utils/transport.hpp"
 #include <functional>
 #include <atomic>
 #include <string>
 #include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <optional>
 
 namespace GameAway {
 
+// Where captured input goes
+enum class InputFocus {
+    Mirror,   // This PC and the server (default)
+    Remote,   // Only the server
+    Local     // Only this PC; nothing is sent
+};
+
 class Client {
 public:
     Client();
     ~Client();
     
-    // Connect to server
+    // Connect to server (LOCAL_ADDRESS uses shared memory instead of TCP)
     bool connect(const std::string& serverIp, uint16_t port, const std::string& token);
     
+    // Treat the address passed to connect() as a relay and pair with the
+    // server behind it. Call before connect().
+    void setUseRelay(bool useRelay) { m_useRelay = useRelay; }
+    
     // Disconnect
     void disconnect();
     
+    // Allow/deny/remap rules applied to captured input before it is queued.
+    // Call before connect().
+    bool loadInputRules(const std::string& path, std::string& error) { return m_filter.load(path, error); }
+    uint64_t getEventsFiltered() const { return m_filter.getDropped(); }
+    
+    // Simulate a poor network to the server if the file holds an impairment
+    // profile; no file means the real network only. Call before connect().
+    bool loadImpairment(const std::string& path, std::string& error);
+    
+    // What the simulated network did so far; empty when there is none
+    std::string getImpairmentSummary() const;
+    
     // Pause/resume input capture
     void pause();
     void resume();
     bool isPaused() const { return m_paused.load(); }
     
+    // Route input to the server, this PC or both. Leaving the server
+    // releases whatever is held there first.
+    void setFocus(InputFocus focus);
+    InputFocus getFocus() const { return m_focus.load(); }
+    
+    // Hotkey: Mirror or Local -> Remote, Remote -> Local
+    void toggleFocus();
+    
+    // Have the server type UTF-8 text, e.g. a paste. Sent as a few large
+    // frames in order with other input, not as a keystroke per character;
+    // unlike keystrokes it is not resent after a reconnect.
+    bool sendText(const std::string& text);
+    
     // Check connection status
     bool isConnected() const { return m_connected.load(); }
     
+    // True while a dropped session is being resumed in the background
+    bool isReconnecting() const { return m_reconnecting.load(); }
+    
     // Set callback for status updates
     using StatusCallback = std::function<void(const std::string& status)>;
     void setStatusCallback(StatusCallback callback);
     
+    // Set callback invoked whenever state shown to the user changes (events
+    // sent, connection). Runs on the hook and network threads once per
+    // event, so it must be cheap.
+    using ChangeCallback = std::function<void()>;
+    void setChangeCallback(ChangeCallback callback);
+    
     // Get statistics
     uint64_t getEventsSent() const { return m_eventsSent.load(); }
+    uint64_t getReconnects() const { return m_reconnects.load(); }
+    uint64_t getLoopEventsFiltered() const { return m_inputHook->getLoopEventsFiltered(); }
 
 private:
     std::string m_token;
+    std::string m_pairingId;    // Relay mode only
+    bool m_useRelay = false;
+    size_t m_maxFrameBytes = 0;   // Largest text frame the transport takes whole; set by connect()
     std::unique_ptr<Crypto> m_crypto;
-    std::unique_ptr<ix::WebSocket> m_webSocket;
+    std::unique_ptr<Transport> m_transport;
     std::unique_ptr<InputHook> m_inputHook;
+    std::unique_ptr<GamepadCapture> m_gamepad;
+    InputFilter m_filter;
+    std::optional<ImpairmentProfile> m_impairment;
+    ImpairedTransport* m_impaired = nullptr;   // m_transport, when impaired
+    DisplayWatcher m_displayWatcher;
     StatusCallback m_statusCallback;
+    ChangeCallback m_changeCallback;
     
     std::atomic<bool> m_connected{false};
     std::atomic<bool> m_paused{false};
+    std::atomic<InputFocus> m_focus{InputFocus::Mirror};
+    std::mutex m_focusMutex;   // Serializes focus changes from the hook and main threads
+    
+    // Local desktop bounds for screen-edge focus switching (hook thread reads)
+    std::mutex m_desktopMutex;
+    MonitorRect m_desktop{};
     std::atomic<uint64_t> m_eventsSent{0};
+    std::atomic<uint64_t> m_reconnects{0};
+    
+    // Liveness, in steady clock milliseconds. The server counts as gone
+    // after HEARTBEAT_MISSES silent intervals; we only send it a heartbeat
+    // when nothing else went out for HEARTBEAT_INTERVAL_MS.
+    std::atomic<int64_t> m_lastReceivedMs{0};
+    std::atomic<int64_t> m_lastSentMs{0};
+    
+    // Handshake outcome, shared by the initial connect and reconnect attempts.
+    // Waiters block on m_stateCv; the socket thread signals it in finishHandshake.
+    std::mutex m_stateMutex;
+    std::condition_variable m_stateCv;
+    std::atomic<bool> m_handshakeDone{false};
+    std::atomic<bool> m_handshakeResult{false};
+    
+    // Session resumption state (ticket is issued by the server on accept)
+    std::mutex m_sessionMutex;
+    std::string m_sessionTicket;
+    std::atomic<uint64_t> m_nextSeq{1};
+    
+    // Recent key/button events, replayed after a resume if the server missed them
+    struct PendingEvent {
+        uint64_t seq;
+        PackedInputEvent event;
+    };
+    std::mutex m_retransmitMutex;
+    std::deque<PendingEvent> m_retransmitBuffer;
+    
+    // Two-lane send scheduler. Discrete events (keys, buttons, wheel,
+    // gamepad buttons) and control messages go through a lossless FIFO;
+    // moves and gamepad axes each collapse into a latest-value slot that is
+    // only drained while the socket's send buffer is below SEND_BUFFER_HIGH_WATER.
+    struct OutgoingFrame {
+        uint64_t seq;         // 0 for control messages
+        PackedInputEvent event;
+        std::string control;  // Pre-built control message, sent as-is
+    };
+    std::thread m_sendThread;
+    std::mutex m_sendMutex;
+    std::condition_variable m_sendCv;
+    std::deque<OutgoingFrame> m_priorityLane;
+    std::optional<PendingEvent> m_pendingMove;
+    std::optional<PendingEvent> m_pendingAxes;
+    bool m_sendStopping = false;
+    
+    // Background reconnect worker
+    std::thread m_reconnectThread;
+    bool m_reconnectRequested = false;
+    std::atomic<bool> m_reconnecting{false};
+    std::atomic<bool> m_stopping{false};
+    
+    void onTransportEvent(TransportEvent event, const std::string& data);
+    void sendHandshake(const std::string& cookie);
+    void onAccept(const std::string& encryptedData);
+    void onConnectionLost();
+    void finishHandshake(bool result);
+    void reconnectLoop();
+    void checkHeartbeat();
     
     void onInputEvent(const InputEvent& event);
-    std::string serializeInputEvent(const InputEvent& event);
+    bool crossEdge(const InputEvent& move);
+    void applyFocus(InputFocus focus);   // m_focusMutex held
+    void releaseRemoteFocus();
+    void refreshDesktop();
+    void enqueueControl(const std::string& message);
+    void sendLoop();
+    void stopSender();
+    bool sendInputEvent(const PackedInputEvent& packed, uint64_t seq);   // False if the transport refused it
+    void replayPending(uint64_t ackedSeq);
+    void sendLayout();
+    std::string serializeInputEvent(const InputEvent& event, uint64_t seq);
     void sendStatus(const std::string& status);
+    void notifyChange();
 };
-
+    
 } // namespace GameAway
@@ -0,0 +1,212 @@
+#include "gamepad_capture.hpp"
+#include "config.hpp"
+#include "utils/logger.hpp"
+#include <Xinput.h>
+#include <cmath>
+#include <cstdlib>
+
+namespace GameAway {
+
+namespace {
+
+constexpr DWORD NO_CONTROLLER = XUSER_MAX_COUNT;
+
+DWORD findController() {
+    for (DWORD slot = 0; slot < XUSER_MAX_COUNT; ++slot) {
+        XINPUT_STATE state{};
+        if (XInputGetState(slot, &state) == ERROR_SUCCESS) {
+            return slot;
+        }
+    }
+    return NO_CONTROLLER;
+}
+
+// Radial deadzone: a resting stick never drifts, and a stick pushed along
+// one axis is not cut off on the other
+void applyStickDeadzone(int16_t& x, int16_t& y, int deadzone) {
+    if (std::hypot(static_cast<double>(x), static_cast<double>(y)) < deadzone) {
+        x = 0;
+        y = 0;
+    }
+}
+
+uint8_t applyTriggerThreshold(uint8_t value) {
+    return value < XINPUT_GAMEPAD_TRIGGER_THRESHOLD ? 0 : value;
+}
+
+// A change worth sending: larger than the noise threshold, or coming to rest
+bool axisChanged(int current, int reported, int epsilon) {
+    if (current == reported) return false;
+    return current == 0 || std::abs(current - reported) >= epsilon;
+}
+
+bool axesChanged(const GamepadState& current, const GamepadState& reported) {
+    return axisChanged(current.thumbLX, reported.thumbLX, GAMEPAD_STICK_EPSILON) ||
+           axisChanged(current.thumbLY, reported.thumbLY, GAMEPAD_STICK_EPSILON) ||
+           axisChanged(current.thumbRX, reported.thumbRX, GAMEPAD_STICK_EPSILON) ||
+           axisChanged(current.thumbRY, reported.thumbRY, GAMEPAD_STICK_EPSILON) ||
+           axisChanged(current.leftTrigger, reported.leftTrigger, GAMEPAD_TRIGGER_EPSILON) ||
+           axisChanged(current.rightTrigger, reported.rightTrigger, GAMEPAD_TRIGGER_EPSILON);
+}
+
+bool isNeutral(const GamepadState& state) {
+    return state.buttons == 0 && state.leftTrigger == 0 && state.rightTrigger == 0 &&
+           state.thumbLX == 0 && state.thumbLY == 0 && state.thumbRX == 0 && state.thumbRY == 0;
+}
+
+} // namespace
+
+GamepadCapture::GamepadCapture() {
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    
+    // Default timer resolution (~15.6 ms) cannot pace a 1 kHz poll
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!m_timer) {
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+}
+
+GamepadCapture::~GamepadCapture() {
+    stop();
+    
+    if (m_timer) CloseHandle(m_timer);
+    if (m_wakeEvent) CloseHandle(m_wakeEvent);
+}
+
+bool GamepadCapture::start(InputCallback callback) {
+    if (m_running.load()) return false;
+    
+    m_callback = std::move(callback);
+    {
+        std::lock_guard<std::mutex> lock(m_stateMutex);
+        m_reported = GamepadState{};
+        m_nextAxes = Clock::now();
+    }
+    
+    m_running.store(true);
+    m_pollThread = std::thread(&GamepadCapture::pollLoop, this);
+    return true;
+}
+
+void GamepadCapture::stop() {
+    if (!m_running.exchange(false)) return;
+    
+    SetEvent(m_wakeEvent);
+    if (m_pollThread.joinable()) {
+        m_pollThread.join();
+    }
+    m_hasController.store(false);
+}
+
+void GamepadCapture::releaseHeld() {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    if (isNeutral(m_reported)) return;
+    
+    if (m_reported.buttons != 0) {
+        m_reported.buttons = 0;
+        emit(InputEventType::GamepadButtons, m_reported);
+    }
+    if (!isNeutral(m_reported)) {
+        m_reported = GamepadState{};
+        emit(InputEventType::GamepadAxes, m_reported);
+    }
+}
+
+void GamepadCapture::resync() {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    m_reported = GamepadState{};
+    m_nextAxes = Clock::now();
+}
+
+void GamepadCapture::report(const GamepadState& state, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(m_stateMutex);
+    
+    // Axes first when both are due, so a button lands with the stick where it was
+    if (now >= m_nextAxes && axesChanged(state, m_reported)) {
+        m_reported.leftTrigger = state.leftTrigger;
+        m_reported.rightTrigger = state.rightTrigger;
+        m_reported.thumbLX = state.thumbLX;
+        m_reported.thumbLY = state.thumbLY;
+        m_reported.thumbRX = state.thumbRX;
+        m_reported.thumbRY = state.thumbRY;
+        m_nextAxes = now + std::chrono::milliseconds(GAMEPAD_AXIS_INTERVAL_MS);
+        emit(InputEventType::GamepadAxes, m_reported);
+    }
+    
+    if (state.buttons != m_reported.buttons) {
+        m_reported.buttons = state.buttons;
+        emit(InputEventType::GamepadButtons, m_reported);
+    }
+}
+
+void GamepadCapture::emit(InputEventType type, const GamepadState& state) {
+    if (!m_callback) return;
+    
+    InputEvent event{};
+    event.type = type;
+    event.gamepad = state;
+    event.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    m_callback(event);
+}
+
+void GamepadCapture::pollLoop() {
+    HANDLE handles[2] = {m_wakeEvent, m_timer};
+    const auto period = std::chrono::microseconds(1000000 / GAMEPAD_POLL_HZ);
+    
+    DWORD slot = NO_CONTROLLER;
+    Clock::time_point nextScan = Clock::now();
+    Clock::time_point nextTick = Clock::now();
+    
+    while (m_running.load()) {
+        Clock::time_point now = Clock::now();
+        
+        if (slot == NO_CONTROLLER && now >= nextScan) {
+            slot = findController();
+            nextScan = now + std::chrono::milliseconds(GAMEPAD_SCAN_INTERVAL_MS);
+            if (slot != NO_CONTROLLER) {
+                m_hasController.store(true);
+                logInfo("Gamepad connected");
+            }
+        }
+        
+        if (slot != NO_CONTROLLER) {
+            XINPUT_STATE raw{};
+            if (XInputGetState(slot, &raw) == ERROR_SUCCESS) {
+                GamepadState state;
+                state.buttons = raw.Gamepad.wButtons;
+                state.leftTrigger = applyTriggerThreshold(raw.Gamepad.bLeftTrigger);
+                state.rightTrigger = applyTriggerThreshold(raw.Gamepad.bRightTrigger);
+                state.thumbLX = raw.Gamepad.sThumbLX;
+                state.thumbLY = raw.Gamepad.sThumbLY;
+                state.thumbRX = raw.Gamepad.sThumbRX;
+                state.thumbRY = raw.Gamepad.sThumbRY;
+                applyStickDeadzone(state.thumbLX, state.thumbLY, XINPUT_GAMEPAD_LEFT_THUMB_DEADZONE);
+                applyStickDeadzone(state.thumbRX, state.thumbRY, XINPUT_GAMEPAD_RIGHT_THUMB_DEADZONE);
+                
+                // Polled every tick, not only on a new packet, so axis
+                // movement held back by the interval still goes out
+                report(state, now);
+            } else {
+                slot = NO_CONTROLLER;
+                m_hasController.store(false);
+                releaseHeld();
+                logInfo("Gamepad disconnected");
+            }
+        }
+        
+        // Without a controller only the next scan matters
+        nextTick = slot == NO_CONTROLLER ? nextScan : nextTick + period;
+        now = Clock::now();
+        if (nextTick < now) nextTick = now;
+        
+        LARGE_INTEGER due;
+        due.QuadPart = -static_cast<LONGLONG>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(nextTick - now).count() / 100);
+        SetWaitableTimer(m_timer, &due, 0, nullptr, nullptr, FALSE);
+        WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    }
+}
+
+} // namespace GameAway
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "input_hook.hpp"
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace GameAway {
+
+// Polls the first connected XInput controller on its own thread and reports
+// changes as gamepad InputEvents. Button changes go out on the poll that sees
+// them. Sticks and triggers get deadzones and a noise threshold, and are
+// reported at most every GAMEPAD_AXIS_INTERVAL_MS with the latest values.
+class GamepadCapture {
+public:
+    GamepadCapture();
+    ~GamepadCapture();
+    
+    // Start polling; a controller plugged in later is picked up
+    bool start(InputCallback callback);
+    
+    // Stop polling
+    void stop();
+    
+    // Report the neutral state (nothing pressed, sticks centred) on the
+    // calling thread if anything else was reported last
+    void releaseHeld();
+    
+    // Forget what was reported, so the next poll reports the full current
+    // state (after the receiver was reset or missed updates)
+    void resync();
+    
+    bool isRunning() const { return m_running.load(); }
+    bool hasController() const { return m_hasController.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    InputCallback m_callback;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_hasController{false};
+    std::thread m_pollThread;
+    
+    HANDLE m_wakeEvent = nullptr;
+    HANDLE m_timer = nullptr;
+    
+    // Last reported state, shared by the poll thread and releaseHeld()
+    std::mutex m_stateMutex;
+    GamepadState m_reported{};
+    Clock::time_point m_nextAxes;
+    
+    void pollLoop();
+    void report(const GamepadState& state, Clock::time_point now);
+    void emit(InputEventType type, const GamepadState& state);
+};
+
+} // namespace GameAway
@@ -1,6 +1,10 @@
 #include "input_hook.hpp"
+#include "config.hpp"
+#include "utils/token.hpp"
+#include "utils/logger.hpp"
 #include <Windows.h>
 #include <chrono>
+#include <algorithm>
 
 namespace GameAway {
 
@@ -9,7 +13,101 @@ InputHook* InputHook::s_instance = nullptr;
 static HHOOK s_keyboardHook = nullptr;
 static HHOOK s_mouseHook = nullptr;
 
-InputHook::InputHook() {
+// Thread messages for the hook thread
+constexpr UINT WM_HOOK_PAUSED = WM_APP + 1;
+constexpr UINT WM_HOOK_RESUMED = WM_APP + 2;
+constexpr UINT WM_HOOK_WARP = WM_APP + 3;
+
+PackedInputEvent packInputEvent(const InputEvent& event) {
+    PackedInputEvent packed{};
+    packed.type = static_cast<uint8_t>(event.type);
+    packed.timeUs = static_cast<uint32_t>(event.timestamp * 1000);
+    
+    switch (event.type) {
+        case InputEventType::KeyDown:
+        case InputEventType::KeyUp:
+            packed.code = static_cast<uint16_t>(event.vkCode);
+            packed.payload.key.scanCode = event.scanCode;
+            break;
+        case InputEventType::MouseWheel:
+            // Wheel deltas come from a WORD, so int16 holds any of them
+            packed.code = static_cast<uint16_t>(static_cast<int16_t>(event.wheelDelta));
+            packed.payload.pointer = {event.x, event.y};
+            break;
+        case InputEventType::GamepadButtons:
+            packed.code = event.gamepad.buttons;
+            break;
+        case InputEventType::GamepadAxes:
+            packed.code = static_cast<uint16_t>(event.gamepad.leftTrigger | event.gamepad.rightTrigger << 8);
+            packed.payload.gamepad = {event.gamepad.thumbLX, event.gamepad.thumbLY,
+                                      event.gamepad.thumbRX, event.gamepad.thumbRY};
+            break;
+        default:
+            packed.code = static_cast<uint16_t>(event.button);
+            packed.payload.pointer = {event.x, event.y};
+            break;
+    }
+    
+    return packed;
+}
+
+InputEvent unpackInputEvent(const PackedInputEvent& packed, uint64_t referenceMs) {
+    InputEvent event{};
+    event.type = static_cast<InputEventType>(packed.type);
+    
+    // Nearest time to the reference whose low 32 microsecond bits match
+    uint64_t referenceUs = referenceMs * 1000;
+    int32_t offsetUs = static_cast<int32_t>(packed.timeUs - static_cast<uint32_t>(referenceUs));
+    event.timestamp = (referenceUs + offsetUs) / 1000;
+    
+    switch (event.type) {
+        case InputEventType::KeyDown:
+        case InputEventType::KeyUp:
+            event.vkCode = packed.code;
+            event.scanCode = packed.payload.key.scanCode;
+            break;
+        case InputEventType::MouseWheel:
+            event.wheelDelta = static_cast<int16_t>(packed.code);
+            event.x = packed.payload.pointer.x;
+            event.y = packed.payload.pointer.y;
+            break;
+        case InputEventType::GamepadButtons:
+            event.gamepad.buttons = packed.code;
+            break;
+        case InputEventType::GamepadAxes:
+            event.gamepad.leftTrigger = static_cast<uint8_t>(packed.code & 0xFF);
+            event.gamepad.rightTrigger = static_cast<uint8_t>(packed.code >> 8);
+            event.gamepad.thumbLX = packed.payload.gamepad.thumbLX;
+            event.gamepad.thumbLY = packed.payload.gamepad.thumbLY;
+            event.gamepad.thumbRX = packed.payload.gamepad.thumbRX;
+            event.gamepad.thumbRY = packed.payload.gamepad.thumbRY;
+            break;
+        default:
+            event.button = packed.code;
+            event.x = packed.payload.pointer.x;
+            event.y = packed.payload.pointer.y;
+            break;
+    }
+    
+    return event;
+}
+
+KeyRepeatTiming queryKeyRepeatTiming() {
+    // Settings are indexes: delay 0-3 is 250-1000 ms, speed 0-31 is about
+    // 2.5-30 repeats per second
+    UINT delay = 1;
+    DWORD speed = 31;
+    SystemParametersInfoW(SPI_GETKEYBOARDDELAY, 0, &delay, 0);
+    SystemParametersInfoW(SPI_GETKEYBOARDSPEED, 0, &speed, 0);
+    
+    KeyRepeatTiming timing;
+    timing.delayMs = 250 * (static_cast<int>(std::min<UINT>(delay, 3)) + 1);
+    double perSecond = 2.5 + std::min<DWORD>(speed, 31) * (27.5 / 31.0);
+    timing.intervalMs = static_cast<int>(1000.0 / perSecond + 0.5);
+    return timing;
+}
+
+InputHook::InputHook() : m_marker(getInjectionMarker()), m_unhookDelay(std::chrono::milliseconds(HOOK_UNHOOK_DELAY_MS)) {
     s_instance = this;
 }
 
@@ -25,8 +123,17 @@ bool InputHook::start(InputCallback callback) {
     m_running.store(true);
     m_paused.store(false);
     
-    // Start message loop in separate thread
-    m_messageThread = std::thread(&InputHook::messageLoop, this);
+    // Start message loop in separate thread, and wait until it has a
+    // message queue so nothing posted to it from here on is lost
+    std::promise<bool> ready;
+    std::future<bool> hooked = ready.get_future();
+    m_messageThread = std::thread(&InputHook::messageLoop, this, std::move(ready));
+    
+    if (!hooked.get()) {
+        m_messageThread.join();
+        logError("Failed to install the input hooks");
+        return false;
+    }
     
     return true;
 }
@@ -37,8 +144,7 @@ void InputHook::stop() {
     m_running.store(false);
     
     // Post quit message to break message loop
-    auto handle = reinterpret_cast<HANDLE>(m_messageThread.native_handle());
-    PostThreadMessage(GetThreadId(handle), WM_QUIT, 0, 0);
+    PostThreadMessage(m_threadId.load(), WM_QUIT, 0, 0);
     
     if (m_messageThread.joinable()) {
         m_messageThread.join();
@@ -46,15 +152,140 @@ void InputHook::stop() {
 }
 
 void InputHook::pause() {
-    m_paused.store(true);
+    if (m_paused.exchange(true)) return;
+    
+    releaseHeld();
+    
+    // Let the hook thread arm the unhook timer
+    postToHookThread(WM_HOOK_PAUSED);
 }
 
 void InputHook::resume() {
-    m_paused.store(false);
+    if (!m_paused.exchange(false)) return;
+    
+    // Lost, the hooks would stay removed after an unhook and capture stay dead
+    if (!postToHookThread(WM_HOOK_RESUMED)) {
+        logError("Input capture could not be resumed");
+    }
 }
 
-void InputHook::messageLoop() {
-    // Install hooks (must be done from the thread that will run the message loop)
+void InputHook::warpCursor(int x, int y) {
+    postToHookThread(WM_HOOK_WARP, static_cast<WPARAM>(static_cast<UINT>(x)), static_cast<LPARAM>(y));
+}
+
+bool InputHook::postToHookThread(UINT message, WPARAM wParam, LPARAM lParam) {
+    // Not started: pause state is reset by start() and there is nothing to warp
+    if (!m_running.load()) return true;
+    
+    // Fails only if the thread has exited or its queue is full
+    if (!PostThreadMessage(m_threadId.load(), message, wParam, lParam)) {
+        logWarn("Hook thread message lost, error " + std::to_string(GetLastError()));
+        return false;
+    }
+    return true;
+}
+
+bool InputHook::shouldSuppress(const InputEvent& event) const {
+    if (!m_suppressLocal.load()) return false;
+    
+    switch (event.type) {
+        case InputEventType::KeyDown:
+        {
+            // Hotkeys are Ctrl+Shift chords and are dispatched after the hooks
+            int vk = event.vkCode;
+            if (vk == VK_CONTROL || vk == VK_LCONTROL || vk == VK_RCONTROL ||
+                vk == VK_SHIFT || vk == VK_LSHIFT || vk == VK_RSHIFT) {
+                return false;
+            }
+            return !((GetAsyncKeyState(VK_CONTROL) & 0x8000) && (GetAsyncKeyState(VK_SHIFT) & 0x8000));
+        }
+        case InputEventType::MouseButtonDown:
+        case InputEventType::MouseWheel:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool InputHook::trackHeld(const InputEvent& event) {
+    std::lock_guard<std::mutex> lock(m_heldMutex);
+    
+    switch (event.type) {
+        case InputEventType::KeyDown:
+            // Already held: an OS autorepeat, not a new press
+            if (m_heldKeys.test(event.vkCode & 0xFF)) return false;
+            m_heldKeys.set(event.vkCode & 0xFF);
+            break;
+        case InputEventType::KeyUp:
+            m_heldKeys.reset(event.vkCode & 0xFF);
+            break;
+        case InputEventType::MouseButtonDown:
+            if (event.button >= 0 && event.button < 3) m_heldButtons.set(event.button);
+            break;
+        case InputEventType::MouseButtonUp:
+            if (event.button >= 0 && event.button < 3) m_heldButtons.reset(event.button);
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void InputHook::releaseHeld() {
+    std::bitset<256> keys;
+    std::bitset<3> buttons;
+    {
+        std::lock_guard<std::mutex> lock(m_heldMutex);
+        keys = m_heldKeys;
+        buttons = m_heldButtons;
+        m_heldKeys.reset();
+        m_heldButtons.reset();
+    }
+    
+    if (!m_callback) return;
+    
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    
+    // Their real releases will happen while paused (or unhooked) and never be seen
+    for (int vk = 0; vk < 256; ++vk) {
+        if (!keys.test(vk)) continue;
+        
+        InputEvent event{};
+        event.type = InputEventType::KeyUp;
+        event.vkCode = vk;
+        event.scanCode = static_cast<int>(MapVirtualKeyW(vk, MAPVK_VK_TO_VSC_EX));   // Keeps the 0xE0 prefix
+        event.timestamp = timestamp;
+        m_callback(event);
+    }
+    
+    for (int button = 0; button < 3; ++button) {
+        if (!buttons.test(button)) continue;
+        
+        InputEvent event{};
+        event.type = InputEventType::MouseButtonUp;
+        event.button = button;
+        event.timestamp = timestamp;
+        m_callback(event);
+    }
+}
+
+bool InputHook::isOwnInjection(bool injected, ULONG_PTR extraInfo) {
+    if (!injected) return false;
+    
+    if (extraInfo == m_marker) {
+        m_loopEventsFiltered.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    
+    m_foreignInjected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool InputHook::installHooks() {
+    if (m_hooked.load()) return true;
+    
     s_keyboardHook = SetWindowsHookExW(
         WH_KEYBOARD_LL,
         keyboardProc,
@@ -70,35 +301,105 @@ void InputHook::messageLoop() {
     );
     
     if (!s_keyboardHook || !s_mouseHook) {
+        uninstallHooks();
+        return false;
+    }
+    
+    m_hooked.store(true);
+    return true;
+}
+
+void InputHook::uninstallHooks() {
+    if (s_keyboardHook) {
+        UnhookWindowsHookEx(s_keyboardHook);
+        s_keyboardHook = nullptr;
+    }
+    if (s_mouseHook) {
+        UnhookWindowsHookEx(s_mouseHook);
+        s_mouseHook = nullptr;
+    }
+    
+    m_hooked.store(false);
+}
+
+void InputHook::messageLoop(std::promise<bool> ready) {
+    m_threadId.store(GetCurrentThreadId());
+    
+    // The first message call creates this thread's queue; until then
+    // PostThreadMessage to it fails
+    MSG msg;
+    PeekMessage(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+    
+    // Install hooks (must be done from the thread that will run the message loop)
+    if (!installHooks()) {
         m_running.store(false);
+        ready.set_value(false);
         return;
     }
+    ready.set_value(true);
+    
+    UINT_PTR unhookTimer = 0;
     
     // Message loop
-    MSG msg;
     while (m_running.load() && GetMessage(&msg, nullptr, 0, 0) > 0) {
+        if (msg.hwnd == nullptr) {
+            if (msg.message == WM_HOOK_PAUSED) {
+                if (!unhookTimer) {
+                    unhookTimer = SetTimer(nullptr, 0, static_cast<UINT>(m_unhookDelay.load().count()), nullptr);
+                }
+                continue;
+            }
+            if (msg.message == WM_HOOK_WARP) {
+                SetCursorPos(static_cast<int>(static_cast<UINT>(msg.wParam)), static_cast<int>(msg.lParam));
+                continue;
+            }
+            if (msg.message == WM_HOOK_RESUMED) {
+                if (unhookTimer) {
+                    KillTimer(nullptr, unhookTimer);
+                    unhookTimer = 0;
+                }
+                if (!installHooks()) {
+                    logError("Failed to reinstall the input hooks");
+                }
+                continue;
+            }
+            if (msg.message == WM_TIMER && msg.wParam == unhookTimer) {
+                KillTimer(nullptr, unhookTimer);
+                unhookTimer = 0;
+                
+                // Paused long enough: stop sitting in every input event's path
+                if (m_paused.load()) {
+                    uninstallHooks();
+                }
+                continue;
+            }
+        }
+        
         TranslateMessage(&msg);
         DispatchMessage(&msg);
     }
     
-    // Cleanup hooks
-    if (s_keyboardHook) {
-        UnhookWindowsHookEx(s_keyboardHook);
-        s_keyboardHook = nullptr;
-    }
-    if (s_mouseHook) {
-        UnhookWindowsHookEx(s_mouseHook);
-        s_mouseHook = nullptr;
+    if (unhookTimer) {
+        KillTimer(nullptr, unhookTimer);
     }
+    
+    // Cleanup hooks
+    uninstallHooks();
 }
 
 LRESULT CALLBACK InputHook::keyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode >= 0 && s_instance && !s_instance->m_paused.load()) {
         KBDLLHOOKSTRUCT* kbd = reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
         
+        // Input we replayed ourselves must not be captured and sent again
+        if (s_instance->isOwnInjection((kbd->flags & LLKHF_INJECTED) != 0, kbd->dwExtraInfo)) {
+            return CallNextHookEx(s_keyboardHook, nCode, wParam, lParam);
+        }
+        
         InputEvent event{};
         event.vkCode = static_cast<int>(kbd->vkCode);
-        event.scanCode = static_cast<int>(kbd->scanCode);
+        // Carried as the 0xE0 prefix, as replay and held-key tracking expect
+        event.scanCode = static_cast<int>(kbd->scanCode) | ((kbd->flags & LLKHF_EXTENDED) ? 0xE000 : 0);
         event.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::system_clock::now().time_since_epoch()
         ).count();
@@ -116,8 +417,17 @@ LRESULT CALLBACK InputHook::keyboardProc(int nCode, WPARAM wParam, LPARAM lParam
                 return CallNextHookEx(s_keyboardHook, nCode, wParam, lParam);
         }
         
-        if (s_instance->m_callback) {
+        // Autorepeats stay local; the receiver repeats held keys itself
+        bool edge = s_instance->trackHeld(event);
+        
+        if (edge && s_instance->m_callback) {
             s_instance->m_callback(event);
+        } else if (!edge) {
+            s_instance->m_autorepeatsDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        if (s_instance->shouldSuppress(event)) {
+            return 1;
         }
     }
     
@@ -128,9 +438,13 @@ LRESULT CALLBACK InputHook::mouseProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode >= 0 && s_instance && !s_instance->m_paused.load()) {
         MSLLHOOKSTRUCT* mouse = reinterpret_cast<MSLLHOOKSTRUCT*>(lParam);
         
+        if (s_instance->isOwnInjection((mouse->flags & LLMHF_INJECTED) != 0, mouse->dwExtraInfo)) {
+            return CallNextHookEx(s_mouseHook, nCode, wParam, lParam);
+        }
+        
         // Throttle mouse move events (max ~60 updates/second)
         static auto lastMoveTime = std::chrono::steady_clock::now();
-        static constexpr auto MOUSE_THROTTLE_MS = std::chrono::milliseconds(16);
+        static constexpr auto MOUSE_THROTTLE_MS = std::chrono::milliseconds(MOUSE_MOVE_INTERVAL_MS);
         
         InputEvent event{};
         event.x = mouse->pt.x;
@@ -186,8 +500,16 @@ LRESULT CALLBACK InputHook::mouseProc(int nCode, WPARAM wParam, LPARAM lParam) {
                 break;
         }
         
-        if (shouldSend && s_instance->m_callback) {
-            s_instance->m_callback(event);
+        if (shouldSend) {
+            s_instance->trackHeld(event);
+            
+            if (s_instance->m_callback) {
+                s_instance->m_callback(event);
+            }
+            
+            if (s_instance->shouldSuppress(event)) {
+                return 1;
+            }
         }
     }
     
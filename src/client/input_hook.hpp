@@ -8,6 +8,11 @@
 #include <atomic>
 #include <thread>
 #include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <future>
+#include <bitset>
+#include <type_traits>
 
 namespace GameAway {
 
@@ -18,7 +23,21 @@ enum class InputEventType {
     MouseMove,
     MouseButtonDown,
     MouseButtonUp,
-    MouseWheel
+    MouseWheel,
+    GamepadButtons,  // Button set changed; always sent
+    GamepadAxes      // Sticks/triggers moved; coalesced, latest wins
+};
+
+// Controller state in XInput units: XINPUT_GAMEPAD_* button bits,
+// triggers 0-255, sticks -32768..32767
+struct GamepadState {
+    uint16_t buttons;
+    uint8_t leftTrigger;
+    uint8_t rightTrigger;
+    int16_t thumbLX;
+    int16_t thumbLY;
+    int16_t thumbRX;
+    int16_t thumbRY;
 };
 
 // Input event data
@@ -30,9 +49,58 @@ struct InputEvent {
     int y;           // Mouse Y position (absolute or delta)
     int button;      // Mouse button (0=left, 1=right, 2=middle)
     int wheelDelta;  // Mouse wheel delta
+    GamepadState gamepad;  // Gamepad events only
     uint64_t timestamp;
 };
 
+// 16-byte form of InputEvent for queues and buffers, four to a cache line.
+// Each kind only keeps the fields it uses, and the timestamp keeps the low
+// 32 bits of its microsecond value; unpacking restores the rest from any
+// reference time within about 35 minutes of the event.
+struct PackedInputEvent {
+    struct KeyPayload {
+        int32_t scanCode;
+        int32_t reserved;
+    };
+    
+    struct PointerPayload {
+        int32_t x;
+        int32_t y;
+    };
+    
+    struct GamepadPayload {
+        int16_t thumbLX;
+        int16_t thumbLY;
+        int16_t thumbRX;
+        int16_t thumbRY;
+    };
+    
+    uint8_t type;        // InputEventType
+    uint8_t flags;       // Reserved, zero
+    uint16_t code;       // vkCode for keys, button for buttons, int16 delta for the wheel,
+                         // button bits for gamepad buttons, triggers (left | right << 8) for axes
+    uint32_t timeUs;
+    union {
+        KeyPayload key;
+        PointerPayload pointer;
+        GamepadPayload gamepad;
+    } payload;
+};
+
+static_assert(sizeof(PackedInputEvent) == 16, "PackedInputEvent must stay 16 bytes");
+static_assert(std::is_trivially_copyable<PackedInputEvent>::value, "PackedInputEvent is copied as raw bytes");
+
+PackedInputEvent packInputEvent(const InputEvent& event);
+InputEvent unpackInputEvent(const PackedInputEvent& packed, uint64_t referenceMs);
+
+// Keyboard autorepeat timing from this machine's settings
+struct KeyRepeatTiming {
+    int delayMs;      // Held this long before the first repeat
+    int intervalMs;   // Between repeats
+};
+
+KeyRepeatTiming queryKeyRepeatTiming();
+
 // Callback type for input events
 using InputCallback = std::function<void(const InputEvent&)>;
 
@@ -41,27 +109,77 @@ public:
     InputHook();
     ~InputHook();
     
-    // Start capturing input events
+    // Start capturing input events. Returns once the hook thread can take
+    // messages; false if the hooks could not be installed.
     bool start(InputCallback callback);
     
     // Stop capturing
     void stop();
     
-    // Pause/resume without stopping
+    // Pause/resume without stopping. Pausing first reports key/button
+    // releases for everything still held, on the calling thread, so the
+    // receiver is never left with stuck input.
     void pause();
     void resume();
     bool isPaused() const { return m_paused.load(); }
     
+    // While paused longer than this the hooks are removed entirely, so
+    // system-wide input no longer passes through this process
+    void setUnhookDelay(std::chrono::milliseconds delay) { m_unhookDelay.store(delay); }
+    
     // Check if running
     bool isRunning() const { return m_running.load(); }
+    
+    // Check if the low-level hooks are currently installed
+    bool isHooked() const { return m_hooked.load(); }
+    
+    // Events skipped because we injected them ourselves (mirroring loop)
+    uint64_t getLoopEventsFiltered() const { return m_loopEventsFiltered.load(); }
+    
+    // Events injected by other software that were still forwarded
+    uint64_t getForeignInjectedEvents() const { return m_foreignInjected.load(); }
+    
+    // OS autorepeats of held keys that were not forwarded
+    uint64_t getAutorepeatsDropped() const { return m_autorepeatsDropped.load(); }
+    
+    // Swallow captured key presses, clicks and wheel turns after reporting
+    // them, so they only reach the remote machine. Moves and releases still
+    // pass (the cursor keeps its position, nothing is left held), as do
+    // Ctrl+Shift chords so the hotkeys keep working.
+    void setSuppressLocal(bool suppress) { m_suppressLocal.store(suppress); }
+    
+    // Report releases for every key and button still held, on the calling thread
+    void releaseHeld();
+    
+    // Move the local cursor from the hook thread, outside the hook procedures
+    void warpCursor(int x, int y);
 
 private:
     InputCallback m_callback;
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_paused{false};
+    std::atomic<bool> m_hooked{false};
+    std::atomic<bool> m_suppressLocal{false};
+    std::atomic<DWORD> m_threadId{0};
+    std::atomic<uint64_t> m_loopEventsFiltered{0};
+    std::atomic<uint64_t> m_foreignInjected{0};
+    std::atomic<uint64_t> m_autorepeatsDropped{0};
+    ULONG_PTR m_marker;
+    std::atomic<std::chrono::milliseconds> m_unhookDelay;   // Read by the hook thread
     std::thread m_messageThread;
     
-    void messageLoop();
+    // Keys and mouse buttons whose press was forwarded and not yet released
+    std::mutex m_heldMutex;
+    std::bitset<256> m_heldKeys;
+    std::bitset<3> m_heldButtons;
+    
+    void messageLoop(std::promise<bool> ready);
+    bool postToHookThread(UINT message, WPARAM wParam = 0, LPARAM lParam = 0);
+    bool installHooks();
+    void uninstallHooks();
+    bool trackHeld(const InputEvent& event);
+    bool isOwnInjection(bool injected, ULONG_PTR extraInfo);
+    bool shouldSuppress(const InputEvent& event) const;
     
     // Static hook procedures (Windows requires static callbacks)
     static InputHook* s_instance;
@@ -8,27 +8,171 @@ namespace GameAway {
 // Network configuration
 constexpr uint16_t DEFAULT_PORT = 8765;
 constexpr int CONNECTION_TIMEOUT_MS = 30000;  // 30 seconds to allow manual approval
+// IXWebSocket still runs one thread per socket, so the thread count grows
+// with connections up to this cap; only one client drives input at a time,
+// so it is kept small
+constexpr size_t SERVER_MAX_CONNECTIONS = 32;
+constexpr int SERVER_LISTEN_BACKLOG = 64;
+constexpr size_t SERVER_MAX_PENDING_APPROVALS = 4;  // Further unknown clients are rejected as busy
+constexpr size_t SERVER_INBOX_FRAMES = 256;  // Frames a connection can queue for the network loop before its reader waits
+constexpr int SERVER_INBOX_WAIT_MS = 50;     // How often a reader waiting on a full inbox checks for shutdown
+
+// Pre-authentication admission control for direct connections
+constexpr size_t ADMISSION_MAX_UNAUTHENTICATED = 16;  // Half of SERVER_MAX_CONNECTIONS, leaving sockets for real clients
+constexpr int ADMISSION_MAX_PER_SOURCE = 2;           // Unauthenticated sockets per IP
+constexpr double ADMISSION_CONNECT_RATE = 1.0;        // New sockets per second per IP
+constexpr double ADMISSION_CONNECT_BURST = 4.0;
+constexpr double ADMISSION_FRAME_RATE = 4.0;          // Frames per second per IP before authentication
+constexpr double ADMISSION_FRAME_BURST = 8.0;
+constexpr size_t ADMISSION_MAX_FRAME_BYTES = 2048;    // Larger frames before authentication are dropped
+constexpr int ADMISSION_HANDSHAKE_TIMEOUT_MS = 5000;  // Sockets that never send a valid CONNECT are closed
+constexpr int ADMISSION_COOKIE_LIFETIME_S = 30;
+constexpr size_t ADMISSION_MAX_SOURCES = 1024;        // Tracked addresses
+constexpr int ADMISSION_SOURCE_IDLE_MS = 60000;       // Idle addresses are forgotten after this
+
+// Relay mode: both peers connect out to a relay, which pairs them by an ID
+// derived from the token and forwards the still-encrypted frames
+constexpr uint16_t RELAY_PORT = 8766;
+constexpr const char* RELAY_PREFIX = "relay:";     // Address prefix selecting relay mode
+constexpr size_t RELAY_MAX_CONNECTIONS = 256;
+constexpr size_t RELAY_MAX_FRAME_BYTES = 4096;     // Larger frames are dropped
+constexpr size_t RELAY_PENDING_FRAMES = 16;        // Queued per socket until its partner arrives
+constexpr int RELAY_RATE_LIMIT_FPS = 2000;         // Sustained frames per second per socket
+constexpr int RELAY_RATE_BURST = 500;
+constexpr int RELAY_PING_INTERVAL_S = 1;           // Peers ping the relay so it can tell a dead socket from an idle one
+constexpr int RELAY_SILENT_TIMEOUT_MS = 3000;      // A registered socket this quiet may be replaced by a new one
+
+// Same-host transport: entering this address on the client uses a shared
+// memory ring instead of TCP loopback
+constexpr const char* LOCAL_ADDRESS = "local";
+constexpr uint32_t SHM_RING_SLOTS = 256;        // Per direction, power of two
+constexpr uint32_t SHM_SLOT_SIZE = 1024;        // Larger messages span several slots
+
+// LAN discovery: servers broadcast a signed beacon, clients cache what they hear
+constexpr uint16_t DISCOVERY_PORT = 8767;
+constexpr int DISCOVERY_VERSION = 2;
+constexpr int DISCOVERY_INTERVAL_MS = 1000;
+constexpr int DISCOVERY_TTL_MS = 5000;        // Cached servers expire after missing a few beacons
+constexpr int DISCOVERY_WAIT_MS = 2000;       // How long the client waits for a matching beacon
+constexpr int DISCOVERY_MAX_SKEW_S = 60;      // Older beacons are treated as replays
 
 // Token configuration
 constexpr size_t TOKEN_LENGTH = 6;
 
+// Client identity and approval allowlist (stored in the data directory)
+constexpr size_t CLIENT_ID_LENGTH = 16;
+constexpr const char* CLIENT_ID_FILE = "client_id.txt";
+constexpr const char* TRUSTED_CLIENTS_FILE = "trusted_clients.txt";
+constexpr const char* INPUT_RULES_FILE = "input_rules.txt";   // Allow/deny/remap rules, see utils/input_filter.hpp
+constexpr const char* IMPAIRMENT_FILE = "impairment.txt";     // Test setups only: simulated network, see utils/impaired_transport.hpp
+
+// Session resumption
+constexpr size_t SESSION_TICKET_LENGTH = 24;
+constexpr int SESSION_TICKET_TTL_MS = 300000;     // Server keeps a dropped session resumable for 5 minutes
+constexpr int RECONNECT_BASE_DELAY_MS = 50;       // First retry delay, doubled per attempt
+constexpr int RECONNECT_MAX_DELAY_MS = 5000;
+constexpr int RECONNECT_MAX_ATTEMPTS = 20;
+constexpr int HEARTBEAT_INTERVAL_MS = 100;        // Idle side sends a heartbeat this often; any frame counts as one
+constexpr int HEARTBEAT_MISSES = 6;               // Silent intervals before the peer is declared dead; 600 ms outlasts one 300 ms minimum RTO retransmit
+constexpr size_t RETRANSMIT_BUFFER_SIZE = 64;     // Recent key/button events kept for replay
+
 // Pause shortcut: Ctrl+Shift+P
 constexpr int PAUSE_MODIFIER_CTRL = 0x0002;  // MOD_CONTROL
 constexpr int PAUSE_MODIFIER_SHIFT = 0x0004; // MOD_SHIFT
 constexpr int PAUSE_KEY = 0x50;              // 'P' key
 
+// Key autorepeat: only press/release edges are sent, and the receiver
+// repeats the held key at the sender's keyboard settings, clamped to these
+constexpr int KEY_REPEAT_MIN_DELAY_MS = 100;
+constexpr int KEY_REPEAT_MAX_DELAY_MS = 2000;
+constexpr int KEY_REPEAT_MIN_INTERVAL_MS = 16;
+constexpr int KEY_REPEAT_MAX_INTERVAL_MS = 1000;
+
+// Remove the input hooks after being paused this long (re-installed on resume)
+constexpr int HOOK_UNHOOK_DELAY_MS = 2000;
+
 // Performance
-constexpr int MAX_LATENCY_MS = 200;
+constexpr int MAX_LATENCY_MS = 200;  // p99 capture-to-replay budget checked when the server exits
+
+// Latency check (--latency-check): a server and a "local" client in one
+// process, driven by moves and key presses sent with SendInput through the
+// client's hooks; exits non-zero when p99 is over budget
+constexpr uint16_t LATENCY_CHECK_PORT = 8768;
+constexpr int LATENCY_CHECK_RATE_HZ = 250;      // Default events per second
+constexpr int LATENCY_CHECK_SECONDS = 10;       // Default duration
+constexpr int LATENCY_CHECK_DRAIN_MS = 500;     // Time for the last events to be replayed
+constexpr int STATUS_REFRESH_MS = 100;  // Minimum interval between status line redraws
+
+// Send scheduling: moves are held back while this much is queued on the socket
+constexpr size_t SEND_BUFFER_HIGH_WATER = 16 * 1024;
+constexpr int SEND_CONGESTION_POLL_MS = 2;
+
+// Sender move throttling; the receiver interpolates between samples
+constexpr int MOUSE_MOVE_INTERVAL_MS = 16;
+
+// Gamepad forwarding (first connected XInput controller)
+constexpr bool GAMEPAD_ENABLED = true;
+constexpr int GAMEPAD_POLL_HZ = 1000;           // Button changes are reported within one poll
+constexpr int GAMEPAD_AXIS_INTERVAL_MS = 4;     // Stick/trigger updates sent at most this often, latest wins
+constexpr int GAMEPAD_STICK_EPSILON = 256;      // Smaller stick changes are not sent
+constexpr int GAMEPAD_TRIGGER_EPSILON = 2;
+constexpr int GAMEPAD_SCAN_INTERVAL_MS = 1000;  // Probing empty controller slots is slow, so not every poll
+
+// Receiver cursor interpolation (0 disables)
+constexpr int CURSOR_OUTPUT_HZ = 240;
+constexpr int CURSOR_EXTRAPOLATE_MS = 8;  // Dead-reckoning horizon past the newest sample
+
+// Receiver playout smoothing (jitter buffer)
+constexpr bool PLAYOUT_SMOOTHING = true;
+constexpr bool PLAYOUT_BYPASS_DISCRETE = true;  // Keys/buttons skip the buffer for lowest latency
+constexpr int PLAYOUT_MIN_DELAY_MS = 2;
+constexpr int PLAYOUT_MAX_DELAY_MS = 60;
+constexpr int PLAYOUT_JITTER_MULTIPLIER = 3;    // Target delay = jitter estimate * multiplier
+constexpr int PLAYOUT_OFFSET_WINDOW_MS = 2000;  // Window for the clock offset estimate
+
+// Asynchronous logger
+constexpr uint32_t LOG_THREAD_BUFFER = 64;   // Records per producing thread (power of two)
+constexpr size_t LOG_MAX_MESSAGE = 240;      // Longer messages are truncated
+constexpr int LOG_REPEAT_BURST = 5;          // Identical lines printed per window before suppressing
+constexpr int LOG_REPEAT_WINDOW_MS = 1000;
+
+// Focus routing (KVM style): Ctrl+Shift+F or crossing the server's screen
+// edge switches between driving only the server and only this PC
+enum class ScreenEdge {
+    None,   // Hotkey only
+    Left,
+    Right,
+    Top,
+    Bottom
+};
+constexpr ScreenEdge ROUTING_SERVER_EDGE = ScreenEdge::Right;  // Side of this desktop the server sits on
+constexpr bool ROUTING_SUPPRESS_LOCAL = true;   // Input for the server does not also reach this PC
+constexpr int ROUTING_WARP_MARGIN = 16;         // Pixels from the opposite edge the cursor lands after crossing
+
+// Pasted text is sent as whole strings and typed on the receiver in paced batches
+constexpr size_t TEXT_MAX_BYTES = 64 * 1024;   // Largest paste accepted (UTF-8)
+constexpr size_t TEXT_QUEUE_UNITS = 2 * TEXT_MAX_BYTES;  // UTF-16 units the server queues; a paste never has more units than UTF-8 bytes
+constexpr size_t TEXT_FRAME_BYTES = 4096;      // Largest text frame as sent, after escaping, encryption and base64
+constexpr size_t TEXT_BATCH_CHARS = 64;        // Characters per SendInput call
+constexpr int TEXT_BATCH_INTERVAL_MS = 8;      // Gap between batches so target apps keep up
+constexpr int TEXT_MODIFIER_WAIT_MS = 2000;    // Longest wait for Shift/Ctrl/Alt/Win to be released before typing
 
 // Message types
 namespace MsgType {
     constexpr const char* CONNECT = "connect";
+    constexpr const char* REATTACH = "reattach";
     constexpr const char* KEY = "key";
     constexpr const char* MOUSE = "mouse";
+    constexpr const char* GAMEPAD = "gamepad";
+    constexpr const char* TEXT = "text";
+    constexpr const char* LAYOUT = "layout";
     constexpr const char* PAUSE = "pause";
     constexpr const char* RESUME = "resume";
     constexpr const char* ACCEPT = "accept";
     constexpr const char* REJECT = "reject";
+    constexpr const char* CHALLENGE = "challenge";  // Cookie the client must echo in CONNECT
+    constexpr const char* PAIR = "pair";      // Relay registration, never forwarded
+    constexpr const char* HEARTBEAT = "hb";   // Liveness only, when nothing else was sent
 }
-
+    
 } // namespace GameAway
@@ -2,11 +2,20 @@
 #include "utils/token.hpp"
 #include "server/server.hpp"
 #include "client/client.hpp"
+#include "relay/relay.hpp"
+#include "utils/event_loop.hpp"
+#include "utils/discovery.hpp"
+#include "utils/logger.hpp"
 
 #include <ixwebsocket/IXNetSystem.h>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <atomic>
+#include <cstdlib>
+#include <cwctype>
+#include <deque>
+#include <mutex>
 #include <thread>
 #include <Windows.h>
 
@@ -15,8 +24,35 @@ using namespace GameAway;
 std::atomic<bool> g_paused{false};
 std::atomic<bool> g_running{true};
 
+// Loop of the active mode, so the console handler can wake it on Ctrl+C
+std::mutex g_loopMutex;
+EventLoop* g_loop = nullptr;
+
 // Global hotkey ID
 constexpr int HOTKEY_PAUSE = 1;
+constexpr int HOTKEY_PASTE = 2;
+constexpr int HOTKEY_FOCUS = 3;
+
+// Clipboard text as UTF-8, empty if there is none
+std::string readClipboardText() {
+    std::string text;
+    if (!OpenClipboard(nullptr)) return text;
+    
+    HANDLE data = GetClipboardData(CF_UNICODETEXT);
+    const wchar_t* wide = data ? static_cast<const wchar_t*>(GlobalLock(data)) : nullptr;
+    if (wide) {
+        int length = WideCharToMultiByte(CP_UTF8, 0, wide, -1, nullptr, 0, nullptr, nullptr);
+        if (length > 1) {
+            text.resize(static_cast<size_t>(length));
+            WideCharToMultiByte(CP_UTF8, 0, wide, -1, &text[0], length, nullptr, nullptr);
+            text.resize(static_cast<size_t>(length - 1));  // Drop the terminator
+        }
+        GlobalUnlock(data);
+    }
+    
+    CloseClipboard();
+    return text;
+}
 
 void printHeader() {
     std::cout << "\n";
@@ -27,22 +63,133 @@ void printHeader() {
     std::cout << "\n";
 }
 
-void printStatus(bool isServer, bool paused, uint64_t events) {
+void printStatus(bool isServer, bool paused, uint64_t events, uint64_t loopFiltered = 0) {
     static uint64_t lastEvents = 0;
+    static uint64_t lastLoopFiltered = 0;
     static bool lastPaused = false;
     
     // Only update if something changed
-    if (events != lastEvents || paused != lastPaused) {
+    if (events != lastEvents || paused != lastPaused || loopFiltered != lastLoopFiltered) {
         lastEvents = events;
         lastPaused = paused;
+        lastLoopFiltered = loopFiltered;
         
         std::cout << "\r[" << (paused ? "PAUSED" : "ACTIVE") << "] ";
         std::cout << (isServer ? "Events received: " : "Events sent: ") << events;
+        if (loopFiltered > 0) {
+            std::cout << " | Loop-filtered: " << loopFiltered;
+        }
         std::cout << " | Ctrl+Shift+P to " << (paused ? "resume" : "pause");
         std::cout << "          " << std::flush;
     }
 }
 
+void printRelayStatus(size_t paired, uint64_t forwarded, uint64_t dropped) {
+    std::cout << "\r[RELAY] Paired sessions: " << paired;
+    std::cout << " | Frames forwarded: " << forwarded;
+    std::cout << " | Dropped: " << dropped;
+    std::cout << "          " << std::flush;
+}
+
+// Split "host[:port]", keeping defaultPort when no valid port is given
+void parseHostPort(const std::string& address, uint16_t defaultPort, std::string& host, uint16_t& port) {
+    host = address;
+    port = defaultPort;
+    
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) return;
+    
+    try {
+        int parsed = std::stoi(address.substr(colon + 1));
+        if (parsed > 0 && parsed <= 65535) {
+            host = address.substr(0, colon);
+            port = static_cast<uint16_t>(parsed);
+        }
+    } catch (...) {
+        // Not a port; treat the whole string as the host
+    }
+}
+
+void setActiveLoop(EventLoop* loop) {
+    std::lock_guard<std::mutex> lock(g_loopMutex);
+    g_loop = loop;
+}
+
+// Connection requests, asked one at a time on the console. The answer is
+// read from the console input handle the loop waits on, so the pause
+// hotkey, status and shutdown keep working while a request is open.
+class ApprovalPrompt {
+public:
+    ApprovalPrompt(Server& server, EventLoop& loop)
+        : m_server(server), m_loop(loop), m_input(GetStdHandle(STD_INPUT_HANDLE)) {
+        DWORD mode = 0;
+        m_console = m_input != INVALID_HANDLE_VALUE && m_input && GetConsoleMode(m_input, &mode);
+    }
+    
+    void add(const ApprovalRequest& request) {
+        if (!m_console) {
+            logWarn("No console to ask on; rejected connection from " + request.pcName);
+            m_server.answerApproval(request.id, false);
+            return;
+        }
+        
+        m_pending.push_back(request);
+        if (!m_open) {
+            showNext();
+        }
+    }
+    
+    // Status redraws would overwrite the question
+    bool isOpen() const { return m_open; }
+
+private:
+    void showNext() {
+        m_open = !m_pending.empty();
+        if (!m_open) {
+            m_loop.unwatchHandle(m_input);
+            return;
+        }
+        
+        const ApprovalRequest& request = m_pending.front();
+        std::cout << "\n[CONNECTION REQUEST]\n";
+        std::cout << "PC Name: " << request.pcName << "\n";
+        std::cout << "Client ID: " << request.clientId << "\n";
+        std::cout << "Accept connection? (y/n, a = always for this client): " << std::flush;
+        
+        // Keys typed before the question was shown do not answer it
+        FlushConsoleInputBuffer(m_input);
+        m_loop.watchHandle(m_input, [this]() { onInput(); });
+    }
+    
+    // Consumes every pending record, so the handle does not stay signalled
+    void onInput() {
+        DWORD available = 0;
+        while (m_open && GetNumberOfConsoleInputEvents(m_input, &available) && available > 0) {
+            INPUT_RECORD record;
+            DWORD read = 0;
+            if (!ReadConsoleInputW(m_input, &record, 1, &read) || read == 0) break;
+            
+            if (record.EventType != KEY_EVENT || !record.Event.KeyEvent.bKeyDown) continue;
+            
+            wchar_t key = static_cast<wchar_t>(towlower(record.Event.KeyEvent.uChar.UnicodeChar));
+            if (key != L'y' && key != L'n' && key != L'a') continue;
+            
+            std::cout << static_cast<char>(key) << "\n";
+            ApprovalRequest request = m_pending.front();
+            m_pending.pop_front();
+            m_server.answerApproval(request.id, key != L'n', key == L'a');
+            showNext();
+        }
+    }
+    
+    Server& m_server;
+    EventLoop& m_loop;
+    HANDLE m_input;
+    bool m_console = false;
+    bool m_open = false;
+    std::deque<ApprovalRequest> m_pending;
+};
+
 void runServer() {
     std::string token = generateToken(TOKEN_LENGTH);
     
@@ -52,21 +199,38 @@ void runServer() {
     std::cout << "║  Connection Token: " << token << "    ║\n";
     std::cout << "╚═══════════════════════════════════════╝\n";
     std::cout << "\nShare this token with the client.\n";
-    std::cout << "Waiting for connection on port " << DEFAULT_PORT << "...\n\n";
+    
+    std::string relayAddress;
+    std::cout << "Relay address (leave empty for direct connections): ";
+    std::getline(std::cin, relayAddress);
+    
+    // Declared first so it outlives the server callbacks that signal it
+    EventLoop loop;
     
     Server server(DEFAULT_PORT);
     server.setToken(token);
     
-    server.setApprovalCallback([](const std::string& pcName) {
-        std::cout << "\n[CONNECTION REQUEST]\n";
-        std::cout << "PC Name: " << pcName << "\n";
-        std::cout << "Accept connection? (y/n): ";
-        
-        char response;
-        std::cin >> response;
+    if (relayAddress.empty()) {
+        std::cout << "Waiting for connection on port " << DEFAULT_PORT << "...\n\n";
+    } else {
+        std::string relayHost;
+        uint16_t relayPort;
+        parseHostPort(relayAddress, RELAY_PORT, relayHost, relayPort);
+        server.setRelay(relayHost, relayPort);
         
-        return (response == 'y' || response == 'Y');
-    });
+        std::cout << "Waiting for connection via relay " << relayHost << ":" << relayPort << "...\n";
+        std::cout << "Clients connect with " << RELAY_PREFIX << relayAddress << "\n\n";
+    }
+    server.loadTrustedClients(getDataPath(TRUSTED_CLIENTS_FILE));
+    
+    std::string rulesError;
+    if (!server.loadInputRules(getDataPath(INPUT_RULES_FILE), rulesError)) {
+        logWarn("Input rules not loaded: " + rulesError);
+    }
+    
+    // Network threads only wake the loop; requests are answered from it
+    server.setApprovalCallback([&loop](const ApprovalRequest&) { loop.signal(); });
+    server.setChangeCallback([&loop]() { loop.signal(); });
     
     if (!server.start()) {
         std::cerr << "Failed to start server!\n";
@@ -78,27 +242,73 @@ void runServer() {
     // Register hotkey
     RegisterHotKey(nullptr, HOTKEY_PAUSE, MOD_CONTROL | MOD_SHIFT, 'P');
     
-    MSG msg;
-    while (g_running.load() && server.isRunning()) {
-        // Check for hotkey
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_PAUSE) {
-                if (g_paused.load()) {
-                    g_paused.store(false);
-                    server.resume();
-                } else {
-                    g_paused.store(true);
-                    server.pause();
-                }
+    ApprovalPrompt prompt(server, loop);
+    
+    loop.setMessageHandler([&](const MSG& msg) {
+        if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_PAUSE) {
+            if (g_paused.load()) {
+                g_paused.store(false);
+                server.resume();
+            } else {
+                g_paused.store(true);
+                server.pause();
+            }
+            if (!prompt.isOpen()) {
+                printStatus(true, g_paused.load(), server.getEventsReceived());
             }
         }
+    });
+    
+    bool statusScheduled = false;
+    loop.setSignalHandler([&]() {
+        if (!server.isRunning()) {
+            loop.stop();
+            return;
+        }
+        
+        ApprovalRequest request;
+        while (server.nextApprovalRequest(request)) {
+            prompt.add(request);
+        }
         
-        printStatus(true, g_paused.load(), server.getEventsReceived());
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        // Redraw at most every STATUS_REFRESH_MS however fast events arrive
+        if (!statusScheduled) {
+            statusScheduled = true;
+            loop.runAfter(std::chrono::milliseconds(STATUS_REFRESH_MS), [&]() {
+                statusScheduled = false;
+                if (!prompt.isOpen()) {
+                    printStatus(true, g_paused.load(), server.getEventsReceived());
+                }
+            });
+        }
+    });
+    
+    setActiveLoop(&loop);
+    if (g_running.load()) {
+        loop.signal();
+        loop.run();
     }
+    setActiveLoop(nullptr);
     
     UnregisterHotKey(nullptr, HOTKEY_PAUSE);
     server.stop();
+    
+    const LatencyHistogram& latency = server.getLatency();
+    if (latency.count() > 0) {
+        bool withinBudget = latency.percentileMs(0.99) <= MAX_LATENCY_MS;
+        std::cout << "\nCapture-to-replay latency: " << latency.summary()
+                  << (withinBudget ? " (within " : " (OVER ") << MAX_LATENCY_MS << " ms budget)\n";
+    }
+    
+    // Steady-state frames should add nothing here once the buffers have grown
+    if (server.getInputFrames() > 0) {
+        std::cout << "Receive path: " << server.getReceiveAllocations() << " heap allocations over "
+                  << server.getInputFrames() << " input frames";
+        if (server.getFramesDropped() > 0) {
+            std::cout << ", " << server.getFramesDropped() << " frames dropped";
+        }
+        std::cout << "\n";
+    }
 }
 
 void runClient() {
@@ -106,16 +316,17 @@ void runClient() {
     std::cout << "║              CLIENT MODE              ║\n";
     std::cout << "╚═══════════════════════════════════════╝\n\n";
     
+    // Listen for server beacons while the user types, so the cache is warm
+    DiscoveryListener discovery;
+    discovery.start();
+    
     std::string serverIp;
     std::string token;
     
-    std::cout << "Enter server IP address: ";
+    std::cout << "Enter server IP address (empty to find it on the network, " << LOCAL_ADDRESS
+              << " for this PC, or " << RELAY_PREFIX << "<address>): ";
     std::getline(std::cin, serverIp);
     
-    if (serverIp.empty()) {
-        serverIp = "localhost";
-    }
-    
     std::cout << "Enter connection token: ";
     std::getline(std::cin, token);
     
@@ -124,69 +335,327 @@ void runClient() {
         return;
     }
     
+    uint16_t port = DEFAULT_PORT;
+    bool useRelay = serverIp.rfind(RELAY_PREFIX, 0) == 0;
+    if (useRelay) {
+        parseHostPort(serverIp.substr(std::string(RELAY_PREFIX).size()), RELAY_PORT, serverIp, port);
+    }
+    
+    if (serverIp.empty()) {
+        // Only a server holding this token can sign a beacon that verifies
+        DiscoveredServer found;
+        if (discovery.findServer(token, std::chrono::milliseconds(DISCOVERY_WAIT_MS), found)) {
+            serverIp = found.address;
+            port = found.port;
+            std::cout << "Found " << found.hostName << " on the local network.\n";
+        } else {
+            std::cout << "No server with this token found on the local network.\n";
+            serverIp = "localhost";
+        }
+    }
+    discovery.stop();
+    
+    // Declared first so it outlives the client callbacks that signal it
+    EventLoop loop;
+    
     Client client;
     
     client.setStatusCallback([](const std::string& status) {
-        std::cout << "\n[STATUS] " << status << "\n";
+        logInfo(status);
     });
+    client.setChangeCallback([&loop]() { loop.signal(); });
+    client.setUseRelay(useRelay);
+    
+    std::string rulesError;
+    if (!client.loadInputRules(getDataPath(INPUT_RULES_FILE), rulesError)) {
+        logWarn("Input rules not loaded: " + rulesError);
+    }
     
-    std::cout << "\nConnecting to " << serverIp << ":" << DEFAULT_PORT << "...\n";
+    std::string impairmentError;
+    if (!client.loadImpairment(getDataPath(IMPAIRMENT_FILE), impairmentError)) {
+        logWarn("Network impairment not loaded: " + impairmentError);
+    }
     
-    if (!client.connect(serverIp, DEFAULT_PORT, token)) {
+    std::cout << "\nConnecting to " << serverIp << ":" << port << (useRelay ? " (relay)" : "") << "...\n";
+    
+    if (!client.connect(serverIp, port, token)) {
         std::cerr << "Failed to connect to server!\n";
         return;
     }
     
     std::cout << "\nConnected! Input mirroring active.\n";
-    std::cout << "Press Ctrl+Shift+P to pause/resume. Ctrl+C to exit.\n\n";
+    std::cout << "Press Ctrl+Shift+P to pause/resume, Ctrl+Shift+V to type the clipboard on the server.\n";
+    std::cout << "Ctrl+Shift+F switches input between the server and this PC. Ctrl+C to exit.\n\n";
     
-    // Register hotkey
+    // Register hotkeys
     RegisterHotKey(nullptr, HOTKEY_PAUSE, MOD_CONTROL | MOD_SHIFT, 'P');
+    RegisterHotKey(nullptr, HOTKEY_PASTE, MOD_CONTROL | MOD_SHIFT, 'V');
+    RegisterHotKey(nullptr, HOTKEY_FOCUS, MOD_CONTROL | MOD_SHIFT, 'F');
     
-    MSG msg;
-    while (g_running.load() && client.isConnected()) {
-        // Check for hotkey
-        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_PAUSE) {
-                if (g_paused.load()) {
-                    g_paused.store(false);
-                    client.resume();
-                } else {
-                    g_paused.store(true);
-                    client.pause();
-                }
+    loop.setMessageHandler([&](const MSG& msg) {
+        if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_PAUSE) {
+            if (g_paused.load()) {
+                g_paused.store(false);
+                client.resume();
+            } else {
+                g_paused.store(true);
+                client.pause();
+            }
+            printStatus(false, g_paused.load(), client.getEventsSent(), client.getLoopEventsFiltered());
+        }
+        else if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_PASTE) {
+            std::string text = readClipboardText();
+            if (text.size() > TEXT_MAX_BYTES) {
+                logWarn("Clipboard text too large to type");
+            } else if (!text.empty() && !client.sendText(text)) {
+                logWarn("Not connected - clipboard not sent");
             }
         }
+        else if (msg.message == WM_HOTKEY && msg.wParam == HOTKEY_FOCUS) {
+            client.toggleFocus();
+        }
+    });
+    
+    bool statusScheduled = false;
+    loop.setSignalHandler([&]() {
+        if (!client.isConnected() && !client.isReconnecting()) {
+            loop.stop();
+            return;
+        }
         
-        printStatus(false, g_paused.load(), client.getEventsSent());
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        // Redraw at most every STATUS_REFRESH_MS however fast events arrive
+        if (!statusScheduled) {
+            statusScheduled = true;
+            loop.runAfter(std::chrono::milliseconds(STATUS_REFRESH_MS), [&]() {
+                statusScheduled = false;
+                printStatus(false, g_paused.load(), client.getEventsSent(), client.getLoopEventsFiltered());
+            });
+        }
+    });
+    
+    setActiveLoop(&loop);
+    if (g_running.load()) {
+        loop.signal();
+        loop.run();
     }
+    setActiveLoop(nullptr);
     
     UnregisterHotKey(nullptr, HOTKEY_PAUSE);
+    UnregisterHotKey(nullptr, HOTKEY_PASTE);
+    UnregisterHotKey(nullptr, HOTKEY_FOCUS);
+    
+    std::string impairment = client.getImpairmentSummary();
     client.disconnect();
+    if (!impairment.empty()) {
+        std::cout << "\nSimulated network: " << impairment << "\n";
+    }
+}
+
+void runRelay() {
+    std::cout << "╔═══════════════════════════════════════╗\n";
+    std::cout << "║              RELAY MODE               ║\n";
+    std::cout << "╚═══════════════════════════════════════╝\n";
+    std::cout << "\nListening on port " << RELAY_PORT << ". Frames are forwarded still encrypted.\n\n";
+    
+    // Declared first so it outlives the relay callbacks that signal it
+    EventLoop loop;
+    
+    Relay relay(RELAY_PORT);
+    relay.setChangeCallback([&loop]() { loop.signal(); });
+    
+    if (!relay.start()) {
+        std::cerr << "Failed to start relay!\n";
+        return;
+    }
+    
+    std::cout << "Relay started. Press Ctrl+C to exit.\n\n";
+    
+    bool statusScheduled = false;
+    loop.setSignalHandler([&]() {
+        if (!relay.isRunning()) {
+            loop.stop();
+            return;
+        }
+        
+        // Redraw at most every STATUS_REFRESH_MS however fast frames arrive
+        if (!statusScheduled) {
+            statusScheduled = true;
+            loop.runAfter(std::chrono::milliseconds(STATUS_REFRESH_MS), [&]() {
+                statusScheduled = false;
+                printRelayStatus(relay.getPairedSessions(), relay.getFramesForwarded(), relay.getFramesDropped());
+            });
+        }
+    });
+    
+    setActiveLoop(&loop);
+    if (g_running.load()) {
+        loop.signal();
+        loop.run();
+    }
+    setActiveLoop(nullptr);
+    
+    relay.stop();
+}
+
+// One input for the latency check, injected like a real device so the
+// client's hooks capture it (no marker in dwExtraInfo)
+void sendCheckInput(int step, POINT cursor) {
+    INPUT input{};
+    
+    if (step % 2 == 0) {
+        // Moves between the cursor's position and the pixel to its right
+        int x = cursor.x + (step % 4 == 0 ? 1 : 0);
+        int left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+        int top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+        int width = std::max(2, GetSystemMetrics(SM_CXVIRTUALSCREEN));
+        int height = std::max(2, GetSystemMetrics(SM_CYVIRTUALSCREEN));
+        
+        input.type = INPUT_MOUSE;
+        input.mi.dx = static_cast<LONG>((x - left) * 65535LL / (width - 1));
+        input.mi.dy = static_cast<LONG>((cursor.y - top) * 65535LL / (height - 1));
+        input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
+    } else {
+        // F24 presses and releases: a real key that nothing acts on
+        input.type = INPUT_KEYBOARD;
+        input.ki.wVk = VK_F24;
+        input.ki.dwFlags = step % 4 == 3 ? KEYEVENTF_KEYUP : 0;
+    }
+    
+    SendInput(1, &input, sizeof(INPUT));
+}
+
+// Unattended regression check: a server and a client attached to it over
+// the same-host transport. At 'rateHz' for 'seconds' the rig injects mouse
+// moves and F24 presses with SendInput, which the client's hooks capture
+// and send as usual; the server records each one once injected again.
+// Returns the process exit code: 0 when the p99 capture-to-replay latency
+// is within 'budgetMs', 1 when it is over or nothing arrived, 2 when the
+// rig could not start.
+int runLatencyCheck(int rateHz, int seconds, int budgetMs) {
+    std::cout << "Latency check: " << rateHz << " events/s for " << seconds
+              << " s, p99 budget " << budgetMs << " ms\n";
+    
+    std::string token = generateToken(TOKEN_LENGTH);
+    
+    // Declared first so it outlives the server callbacks that signal it
+    EventLoop loop;
+    
+    Server server(LATENCY_CHECK_PORT);
+    server.setToken(token);
+    server.setApprovalCallback([&loop](const ApprovalRequest&) { loop.signal(); });
+    
+    if (!server.start()) {
+        std::cerr << "Failed to start server!\n";
+        return 2;
+    }
+    
+    loop.setSignalHandler([&]() {
+        ApprovalRequest request;
+        while (server.nextApprovalRequest(request)) {
+            server.answerApproval(request.id, true);
+        }
+    });
+    
+    // Moves stay next to where the cursor already is
+    POINT cursor{};
+    GetCursorPos(&cursor);
+    
+    bool connected = false;
+    std::thread driver([&]() {
+        Client client;
+        connected = client.connect(LOCAL_ADDRESS, LATENCY_CHECK_PORT, token);
+        
+        if (connected) {
+            auto interval = std::chrono::nanoseconds(1000000000LL / rateHz);
+            auto next = std::chrono::steady_clock::now();
+            auto end = next + std::chrono::seconds(seconds);
+            
+            // Whole cycles of move, press, move back, release, so F24 ends up
+            int step = 0;
+            while ((next < end || step % 4 != 0) && g_running.load()) {
+                std::this_thread::sleep_until(next);
+                next += interval;
+                sendCheckInput(step++, cursor);
+            }
+            
+            std::this_thread::sleep_for(std::chrono::milliseconds(LATENCY_CHECK_DRAIN_MS));
+            client.disconnect();
+        }
+        
+        loop.post([&loop]() { loop.stop(); });
+    });
+    
+    setActiveLoop(&loop);
+    loop.run();
+    setActiveLoop(nullptr);
+    
+    driver.join();
+    server.stop();
+    
+    if (!connected) {
+        std::cerr << "Client could not connect to the check server!\n";
+        return 2;
+    }
+    
+    const LatencyHistogram& latency = server.getLatency();
+    bool withinBudget = latency.count() > 0 && latency.percentileMs(0.99) <= budgetMs;
+    std::cout << "Capture-to-replay latency: " << latency.summary()
+              << (withinBudget ? " PASS\n" : " FAIL\n");
+    return withinBudget ? 0 : 1;
 }
 
 BOOL WINAPI ConsoleHandler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_CLOSE_EVENT) {
         g_running.store(false);
+        
+        std::lock_guard<std::mutex> lock(g_loopMutex);
+        if (g_loop) {
+            g_loop->stop();
+        }
         return TRUE;
     }
     return FALSE;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     // Initialize network system (required for IXWebSocket on Windows)
     ix::initNetSystem();
     
+    // Connection threads log through a background writer, never the console directly
+    startLogger();
+    
+    // Work in physical pixels so hook positions and monitor rects agree under DPI scaling
+    SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
+    
     // Setup console handling
     SetConsoleCtrlHandler(ConsoleHandler, TRUE);
     SetConsoleOutputCP(CP_UTF8);
     
+    // GameAway --latency-check [events/s] [seconds] [p99 budget ms]
+    if (argc > 1 && std::string(argv[1]) == "--latency-check") {
+        int settings[3] = {LATENCY_CHECK_RATE_HZ, LATENCY_CHECK_SECONDS, MAX_LATENCY_MS};
+        for (int i = 2; i < argc && i < 5; ++i) {
+            int value = std::atoi(argv[i]);
+            if (value <= 0) {
+                std::cerr << "Usage: " << argv[0] << " --latency-check [events/s] [seconds] [p99 budget ms]\n";
+                stopLogger();
+                return 2;
+            }
+            settings[i - 2] = value;
+        }
+        
+        int result = runLatencyCheck(settings[0], settings[1], settings[2]);
+        stopLogger();
+        ix::uninitNetSystem();
+        return result;
+    }
+    
     printHeader();
     
     std::cout << "Select mode:\n";
     std::cout << "  [1] Server (receive input)\n";
     std::cout << "  [2] Client (send input)\n";
+    std::cout << "  [3] Relay (connect peers that cannot reach each other)\n";
     std::cout << "\nChoice: ";
     
     int choice;
@@ -202,11 +671,16 @@ int main() {
         case 2:
             runClient();
             break;
+        case 3:
+            runRelay();
+            break;
         default:
             std::cerr << "Invalid choice.\n";
+            stopLogger();
             return 1;
     }
     
+    stopLogger();
     std::cout << "\nExiting...\n";
     ix::uninitNetSystem();
     return 0;
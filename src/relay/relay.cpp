@@ -0,0 +1,289 @@
+#include "relay.hpp"
+#include "utils/logger.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+
+using json = nlohmann::json;
+
+namespace GameAway {
+
+namespace {
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+Relay::Relay(uint16_t port) : m_port(port) {
+}
+
+Relay::~Relay() {
+    stop();
+}
+
+void Relay::setChangeCallback(ChangeCallback callback) {
+    m_changeCallback = std::move(callback);
+}
+
+void Relay::notifyChange() {
+    if (m_changeCallback) {
+        m_changeCallback();
+    }
+}
+
+bool Relay::start() {
+    if (m_running.load()) {
+        return false;
+    }
+    
+    m_server = std::make_unique<ix::WebSocketServer>(m_port, "0.0.0.0", 5, RELAY_MAX_CONNECTIONS);
+    
+    // Frames are already compressed-size input events; deflate would only add latency
+    m_server->disablePerMessageDeflate();
+    
+    m_server->setConnectionStateFactory([]() {
+        return std::make_shared<RelaySession>();
+    });
+    
+    m_server->setOnClientMessageCallback(
+        [this](std::shared_ptr<ix::ConnectionState> connectionState,
+               ix::WebSocket& webSocket,
+               const ix::WebSocketMessagePtr& msg) {
+            handleMessage(connectionState, webSocket, msg);
+        }
+    );
+    
+    auto result = m_server->listen();
+    if (!result.first) {
+        logError("Failed to listen: " + result.second);
+        return false;
+    }
+    
+    m_server->start();
+    m_running.store(true);
+    
+    return true;
+}
+
+void Relay::stop() {
+    if (!m_running.load()) return;
+    
+    m_running.store(false);
+    
+    if (m_server) {
+        m_server->stop();
+        m_server.reset();
+    }
+    
+    // Sessions whose Close never came still hold their sockets
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_pairings) {
+        if (entry.second.host) entry.second.host->socket.reset();
+        if (entry.second.peer) entry.second.peer->socket.reset();
+    }
+    m_pairings.clear();
+    m_pairedSessions.store(0);
+}
+
+void Relay::handleMessage(std::shared_ptr<ix::ConnectionState> connectionState,
+                          ix::WebSocket& webSocket,
+                          const ix::WebSocketMessagePtr& msg) {
+    auto session = std::static_pointer_cast<RelaySession>(connectionState);
+    session->lastHeardMs.store(steadyNowMs());
+    
+    if (msg->type == ix::WebSocketMessageType::Open) {
+        // Hold our own reference so the partner can still send to it
+        // while this connection thread is tearing down
+        for (const auto& client : m_server->getClients()) {
+            if (client.get() == &webSocket) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                session->socket = client;
+                break;
+            }
+        }
+    }
+    else if (msg->type == ix::WebSocketMessageType::Message) {
+        if (!session->socket) return;
+        
+        if (!admitFrame(*session, msg->str.size())) {
+            m_framesDropped.fetch_add(1);
+            notifyChange();
+            return;
+        }
+        
+        // Only the first frame is read; everything after it is opaque
+        bool registered;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            registered = session->registered;
+        }
+        
+        if (registered) {
+            forward(session, msg->str);
+        } else if (!registerSession(session, msg->str)) {
+            webSocket.close();
+        }
+    }
+    else if (msg->type == ix::WebSocketMessageType::Close) {
+        unregisterSession(session);
+        
+        std::lock_guard<std::mutex> lock(m_mutex);
+        session->socket.reset();
+    }
+}
+
+bool Relay::registerSession(const std::shared_ptr<RelaySession>& session, const std::string& payload) {
+    std::string pairingId;
+    bool isHost = false;
+    
+    try {
+        json j = json::parse(payload);
+        if (j["type"].get<std::string>() != MsgType::PAIR) return false;
+        
+        pairingId = j["id"].get<std::string>();
+        isHost = j.value("role", "") == "host";
+    } catch (...) {
+        return false;
+    }
+    
+    if (pairingId.empty()) return false;
+    
+    std::shared_ptr<ix::WebSocket> evicted;
+    std::shared_ptr<ix::WebSocket> evictedPartner;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        
+        // The pairing ID travels in the clear, so a newcomer proves nothing:
+        // whoever holds the slot keeps it while its socket is alive. Peers
+        // ping us, so one silent this long has dropped without us noticing;
+        // then the newcomer replaces it and both sides start over, so the
+        // server sees a fresh handshake.
+        Pairing& existing = m_pairings[pairingId];
+        std::shared_ptr<RelaySession> holder = isHost ? existing.host : existing.peer;
+        if (holder) {
+            if (steadyNowMs() - holder->lastHeardMs.load() < RELAY_SILENT_TIMEOUT_MS) {
+                logWarn(std::string("Refused second ") + (isHost ? "host" : "peer") +
+                        " for session " + pairingId);
+                return false;
+            }
+            
+            std::shared_ptr<RelaySession> partner = detachLocked(*holder);
+            evicted = holder->socket;
+            evictedPartner = partner ? partner->socket : nullptr;
+        }
+        
+        session->pairingId = pairingId;
+        session->isHost = isHost;
+        session->registered = true;
+        
+        Pairing& pairing = m_pairings[pairingId];
+        (isHost ? pairing.host : pairing.peer) = session;
+        
+        std::shared_ptr<RelaySession> partner = isHost ? pairing.peer : pairing.host;
+        if (partner) {
+            // Flushed under the lock so nothing the partner sends next can overtake it
+            for (const auto& frame : partner->pending) {
+                session->socket->send(frame);
+                m_framesForwarded.fetch_add(1);
+            }
+            partner->pending.clear();
+            
+            m_pairedSessions.fetch_add(1);
+            logInfo("Paired session " + pairingId);
+        }
+    }
+    
+    if (evicted) evicted->close();
+    if (evictedPartner) evictedPartner->close();
+    
+    notifyChange();
+    return true;
+}
+
+void Relay::unregisterSession(const std::shared_ptr<RelaySession>& session) {
+    std::shared_ptr<ix::WebSocket> partner;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::shared_ptr<RelaySession> paired = detachLocked(*session);
+        if (paired) partner = paired->socket;
+    }
+    
+    // The partner's session state on the far end is now stale; closing it
+    // makes that side reconnect and pair again
+    if (partner) {
+        partner->close();
+        logInfo("Unpaired session " + session->pairingId);
+        notifyChange();
+    }
+}
+
+std::shared_ptr<RelaySession> Relay::detachLocked(RelaySession& session) {
+    if (!session.registered) return nullptr;
+    session.registered = false;
+    session.pending.clear();
+    
+    auto it = m_pairings.find(session.pairingId);
+    if (it == m_pairings.end()) return nullptr;
+    
+    Pairing& pairing = it->second;
+    auto& slot = session.isHost ? pairing.host : pairing.peer;
+    
+    // Already replaced by a newer socket for the same side
+    if (slot.get() != &session) return nullptr;
+    
+    std::shared_ptr<RelaySession> partner = session.isHost ? pairing.peer : pairing.host;
+    if (partner) {
+        partner->registered = false;
+        partner->pending.clear();
+        m_pairedSessions.fetch_sub(1);
+    }
+    
+    m_pairings.erase(it);
+    return partner;
+}
+
+void Relay::forward(const std::shared_ptr<RelaySession>& session, const std::string& payload) {
+    std::shared_ptr<ix::WebSocket> partner;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        
+        auto it = m_pairings.find(session->pairingId);
+        if (it != m_pairings.end()) {
+            auto& slot = session->isHost ? it->second.peer : it->second.host;
+            if (slot) partner = slot->socket;
+        }
+        
+        if (!partner) {
+            if (session->pending.size() >= RELAY_PENDING_FRAMES) {
+                m_framesDropped.fetch_add(1);
+            } else {
+                session->pending.push_back(payload);
+            }
+            return;
+        }
+    }
+    
+    // Handed straight from the receive buffer to the partner's socket
+    partner->send(payload);
+    m_framesForwarded.fetch_add(1);
+    notifyChange();
+}
+
+bool Relay::admitFrame(RelaySession& session, size_t size) {
+    if (size > RELAY_MAX_FRAME_BYTES) return false;
+    
+    // Token bucket: refill at RELAY_RATE_LIMIT_FPS up to RELAY_RATE_BURST
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - session.lastRefill).count();
+    session.lastRefill = now;
+    session.tokens = std::min<double>(RELAY_RATE_BURST, session.tokens + elapsed * RELAY_RATE_LIMIT_FPS);
+    
+    if (session.tokens < 1.0) return false;
+    
+    session.tokens -= 1.0;
+    return true;
+}
+
+} // namespace GameAway
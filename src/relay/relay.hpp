@@ -0,0 +1,91 @@
+#pragma once
+
+#include "config.hpp"
+#include <ixwebsocket/IXWebSocketServer.h>
+#include <functional>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
+
+namespace GameAway {
+
+// A socket connected to the relay. The socket pointer, registration fields
+// and the pending queue are guarded by Relay::m_mutex; the rate limiter
+// belongs to the socket's connection thread.
+class RelaySession : public ix::ConnectionState {
+public:
+    // The socket's callback owns this session, so this reference is dropped
+    // on Close to break the cycle
+    std::shared_ptr<ix::WebSocket> socket;
+    std::string pairingId;
+    bool isHost = false;
+    bool registered = false;
+    std::deque<std::string> pending;    // Frames sent before the partner arrived
+    std::atomic<int64_t> lastHeardMs{0};   // Any frame or ping, steady clock
+    
+    double tokens = RELAY_RATE_BURST;
+    std::chrono::steady_clock::time_point lastRefill = std::chrono::steady_clock::now();
+};
+
+// Forwards frames between a server ("host") and a client ("peer") that both
+// connect out to it, for peers that cannot reach each other directly. Frames
+// stay encrypted end to end; the relay only reads the pairing message.
+class Relay {
+public:
+    Relay(uint16_t port = RELAY_PORT);
+    ~Relay();
+    
+    // Start the relay
+    bool start();
+    
+    // Stop the relay
+    void stop();
+    
+    // Check if running
+    bool isRunning() const { return m_running.load(); }
+    
+    // Set callback invoked whenever the statistics change. Runs on
+    // connection threads once per frame, so it must be cheap.
+    using ChangeCallback = std::function<void()>;
+    void setChangeCallback(ChangeCallback callback);
+    
+    // Get statistics
+    size_t getPairedSessions() const { return m_pairedSessions.load(); }
+    uint64_t getFramesForwarded() const { return m_framesForwarded.load(); }
+    uint64_t getFramesDropped() const { return m_framesDropped.load(); }
+
+private:
+    struct Pairing {
+        std::shared_ptr<RelaySession> host;
+        std::shared_ptr<RelaySession> peer;
+    };
+    
+    uint16_t m_port;
+    std::unique_ptr<ix::WebSocketServer> m_server;
+    ChangeCallback m_changeCallback;
+    
+    std::atomic<bool> m_running{false};
+    std::atomic<size_t> m_pairedSessions{0};
+    std::atomic<uint64_t> m_framesForwarded{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+    
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Pairing> m_pairings;
+    
+    void handleMessage(std::shared_ptr<ix::ConnectionState> connectionState,
+                       ix::WebSocket& webSocket,
+                       const ix::WebSocketMessagePtr& msg);
+    
+    bool registerSession(const std::shared_ptr<RelaySession>& session, const std::string& payload);
+    void unregisterSession(const std::shared_ptr<RelaySession>& session);
+    std::shared_ptr<RelaySession> detachLocked(RelaySession& session);  // Caller holds m_mutex
+    void forward(const std::shared_ptr<RelaySession>& session, const std::string& payload);
+    bool admitFrame(RelaySession& session, size_t size);
+    void notifyChange();
+};
+
+} // namespace GameAway
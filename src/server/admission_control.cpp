@@ -0,0 +1,127 @@
+#include "admission_control.hpp"
+#include "config.hpp"
+#include "utils/token.hpp"
+#include <algorithm>
+
+namespace GameAway {
+
+AdmissionControl::AdmissionControl()
+    : m_cookieKey(generateToken(32)) {
+}
+
+bool AdmissionControl::TokenBucket::take(double rate, double burst,
+                                         std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    tokens = std::min(burst, tokens + elapsed * rate);
+    
+    if (tokens < 1.0) return false;
+    
+    tokens -= 1.0;
+    return true;
+}
+
+bool AdmissionControl::admitConnection(const std::string& ip) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    // Keep sockets free for a real client however many sources are flooding
+    if (m_unauthenticated >= ADMISSION_MAX_UNAUTHENTICATED) {
+        m_connectionsRefused.fetch_add(1);
+        return false;
+    }
+    
+    Source* source = findSource(ip, now);
+    if (!source ||
+        source->unauthenticated >= ADMISSION_MAX_PER_SOURCE ||
+        !source->connects.take(ADMISSION_CONNECT_RATE, ADMISSION_CONNECT_BURST, now)) {
+        m_connectionsRefused.fetch_add(1);
+        return false;
+    }
+    
+    source->unauthenticated++;
+    m_unauthenticated++;
+    return true;
+}
+
+void AdmissionControl::releaseConnection(const std::string& ip) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    auto it = m_sources.find(ip);
+    if (it == m_sources.end() || it->second.unauthenticated == 0) return;
+    
+    it->second.unauthenticated--;
+    m_unauthenticated--;
+}
+
+bool AdmissionControl::admitFrame(const std::string& ip, size_t size) {
+    if (size > ADMISSION_MAX_FRAME_BYTES) {
+        m_framesDropped.fetch_add(1);
+        return false;
+    }
+    
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    Source* source = findSource(ip, now);
+    if (!source || !source->frames.take(ADMISSION_FRAME_RATE, ADMISSION_FRAME_BURST, now)) {
+        m_framesDropped.fetch_add(1);
+        return false;
+    }
+    
+    return true;
+}
+
+std::string AdmissionControl::issueCookie(const std::string& ip, int port) {
+    int64_t window = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() / ADMISSION_COOKIE_LIFETIME_S;
+    
+    return m_cookieKey.sign(cookieMessage(ip, port, window));
+}
+
+bool AdmissionControl::verifyCookie(const std::string& cookie, const std::string& ip, int port) {
+    if (cookie.empty()) return false;
+    
+    int64_t window = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() / ADMISSION_COOKIE_LIFETIME_S;
+    
+    // A cookie issued just before the window turned over is still good
+    return m_cookieKey.verify(cookieMessage(ip, port, window), cookie) ||
+           m_cookieKey.verify(cookieMessage(ip, port, window - 1), cookie);
+}
+
+AdmissionControl::Source* AdmissionControl::findSource(const std::string& ip,
+                                                       std::chrono::steady_clock::time_point now) {
+    auto it = m_sources.find(ip);
+    if (it == m_sources.end()) {
+        if (m_sources.size() >= ADMISSION_MAX_SOURCES) {
+            pruneSources(now);
+            if (m_sources.size() >= ADMISSION_MAX_SOURCES) return nullptr;
+        }
+        
+        Source source;
+        source.connects = {ADMISSION_CONNECT_BURST, now};
+        source.frames = {ADMISSION_FRAME_BURST, now};
+        it = m_sources.emplace(ip, source).first;
+    }
+    
+    it->second.lastSeen = now;
+    return &it->second;
+}
+
+void AdmissionControl::pruneSources(std::chrono::steady_clock::time_point now) {
+    for (auto it = m_sources.begin(); it != m_sources.end();) {
+        if (it->second.unauthenticated == 0 &&
+            now - it->second.lastSeen > std::chrono::milliseconds(ADMISSION_SOURCE_IDLE_MS)) {
+            it = m_sources.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::string AdmissionControl::cookieMessage(const std::string& ip, int port, int64_t window) {
+    return ip + "|" + std::to_string(port) + "|" + std::to_string(window);
+}
+
+} // namespace GameAway
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "utils/crypto.hpp"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GameAway {
+
+// Cheap checks that run before a direct connection has proven it knows the
+// token, so a flood of sockets or CONNECT frames never reaches the crypto
+// on the network loop. Limits are per source address: a cap on sockets that
+// have not authenticated yet, and token buckets for new sockets and for
+// frames sent before authentication. Stateless cookies make a peer echo a
+// value we sent it before its CONNECT is decrypted. Thread-safe.
+class AdmissionControl {
+public:
+    AdmissionControl();
+    
+    // A socket from 'ip' opened; false means close it right away.
+    // A true result must be paired with releaseConnection().
+    bool admitConnection(const std::string& ip);
+    
+    // The socket authenticated or closed and no longer counts as unauthenticated
+    void releaseConnection(const std::string& ip);
+    
+    // A frame arrived on a socket that has not authenticated yet
+    bool admitFrame(const std::string& ip, size_t size);
+    
+    // Cookie bound to the peer's address and the current time window
+    std::string issueCookie(const std::string& ip, int port);
+    bool verifyCookie(const std::string& cookie, const std::string& ip, int port);
+    
+    uint64_t getConnectionsRefused() const { return m_connectionsRefused.load(); }
+    uint64_t getFramesDropped() const { return m_framesDropped.load(); }
+
+private:
+    struct TokenBucket {
+        double tokens;
+        std::chrono::steady_clock::time_point lastRefill;
+        
+        bool take(double rate, double burst, std::chrono::steady_clock::time_point now);
+    };
+    
+    struct Source {
+        int unauthenticated = 0;
+        TokenBucket connects;
+        TokenBucket frames;
+        std::chrono::steady_clock::time_point lastSeen;
+    };
+    
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Source> m_sources;
+    size_t m_unauthenticated = 0;
+    
+    Crypto m_cookieKey;   // Random per process; cookies never outlive it
+    
+    std::atomic<uint64_t> m_connectionsRefused{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+    
+    Source* findSource(const std::string& ip, std::chrono::steady_clock::time_point now);
+    void pruneSources(std::chrono::steady_clock::time_point now);
+    std::string cookieMessage(const std::string& ip, int port, int64_t window);
+};
+
+} // namespace GameAway
@@ -0,0 +1,186 @@
+#include "cursor_interpolator.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace GameAway {
+
+CursorInterpolator::CursorInterpolator(MoveCallback move, int outputHz, int extrapolateMs, ShownCallback shown)
+    : m_move(std::move(move)),
+      m_shown(std::move(shown)),
+      m_period(1000000 / std::max(1, outputHz)),
+      m_extrapolateMs(std::max(0, extrapolateMs)) {
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    
+    // Default timer resolution (~15.6 ms) is far too coarse for 240 Hz output
+    m_timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (!m_timer) {
+        m_timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+    
+    m_thread = std::thread(&CursorInterpolator::outputLoop, this);
+}
+
+CursorInterpolator::~CursorInterpolator() {
+    m_stopping.store(true);
+    SetEvent(m_wakeEvent);
+    
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    
+    if (m_timer) CloseHandle(m_timer);
+    if (m_wakeEvent) CloseHandle(m_wakeEvent);
+}
+
+void CursorInterpolator::onSample(int x, int y, uint64_t timestamp) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Clock::time_point now = Clock::now();
+        
+        if (m_unshownTimestamp == 0) {
+            m_unshownTimestamp = timestamp;
+        }
+        
+        if (!m_hasSample) {
+            m_fromX = x;
+            m_fromY = y;
+        } else {
+            double sinceLast = std::chrono::duration<double, std::milli>(now - m_lastSample).count();
+            m_intervalMs = std::clamp(m_intervalMs * 0.75 + sinceLast * 0.25, 4.0, 50.0);
+            
+            // Continue from wherever the cursor is shown right now
+            int curX, curY;
+            position(now, curX, curY);
+            m_fromX = curX;
+            m_fromY = curY;
+            m_velX = (x - m_toX) / m_intervalMs;
+            m_velY = (y - m_toY) / m_intervalMs;
+        }
+        
+        m_toX = x;
+        m_toY = y;
+        m_segmentStart = now;
+        m_lastSample = now;
+        m_hasSample = true;
+        m_active = true;
+    }
+    
+    SetEvent(m_wakeEvent);
+}
+
+void CursorInterpolator::snap() {
+    std::lock_guard<std::mutex> emitLock(m_emitMutex);
+    
+    int x, y;
+    uint64_t shown;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_hasSample) return;
+        
+        x = m_toX;
+        y = m_toY;
+        m_fromX = x;
+        m_fromY = y;
+        m_velX = m_velY = 0;
+        m_active = false;
+        shown = takeShown();
+    }
+    
+    emit(x, y);
+    if (shown != 0 && m_shown) {
+        m_shown(shown);
+    }
+}
+
+bool CursorInterpolator::position(Clock::time_point now, int& x, int& y) const {
+    double elapsed = std::chrono::duration<double, std::milli>(now - m_segmentStart).count();
+    
+    if (elapsed < m_intervalMs) {
+        double t = elapsed / m_intervalMs;
+        x = static_cast<int>(std::lround(m_fromX + (m_toX - m_fromX) * t));
+        y = static_cast<int>(std::lround(m_fromY + (m_toY - m_fromY) * t));
+        return true;
+    }
+    
+    double ahead = elapsed - m_intervalMs;
+    if (ahead < m_extrapolateMs) {
+        x = static_cast<int>(std::lround(m_toX + m_velX * ahead));
+        y = static_cast<int>(std::lround(m_toY + m_velY * ahead));
+        return true;
+    }
+    
+    // No newer sample: the cursor stopped, settle on the true position
+    x = m_toX;
+    y = m_toY;
+    return false;
+}
+
+uint64_t CursorInterpolator::takeShown() {
+    uint64_t timestamp = m_unshownTimestamp;
+    m_unshownTimestamp = 0;
+    return timestamp;
+}
+
+void CursorInterpolator::emit(int x, int y) {
+    if (m_hasOutput && x == m_outX && y == m_outY) return;
+    
+    m_outX = x;
+    m_outY = y;
+    m_hasOutput = true;
+    m_move(x, y);
+}
+
+void CursorInterpolator::outputLoop() {
+    HANDLE handles[2] = {m_wakeEvent, m_timer};
+    Clock::time_point nextTick = Clock::now();
+    
+    while (!m_stopping.load()) {
+        bool active;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            active = m_active;
+        }
+        
+        if (!active) {
+            WaitForSingleObject(m_wakeEvent, INFINITE);
+            nextTick = Clock::now();
+            continue;
+        }
+        
+        {
+            std::lock_guard<std::mutex> emitLock(m_emitMutex);
+            
+            int x, y;
+            uint64_t shown = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Clock::time_point now = Clock::now();
+                if (!position(now, x, y)) {
+                    m_active = false;
+                }
+                
+                // Past the end of its segment the cursor has reached the sample
+                if (std::chrono::duration<double, std::milli>(now - m_segmentStart).count() >= m_intervalMs) {
+                    shown = takeShown();
+                }
+            }
+            emit(x, y);
+            if (shown != 0 && m_shown) {
+                m_shown(shown);
+            }
+        }
+        
+        // Schedule against the ideal tick grid so the rate does not drift
+        nextTick += m_period;
+        Clock::time_point now = Clock::now();
+        if (nextTick < now) nextTick = now;
+        
+        LARGE_INTEGER due;
+        due.QuadPart = -static_cast<LONGLONG>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(nextTick - now).count() / 100);
+        SetWaitableTimer(m_timer, &due, 0, nullptr, nullptr, FALSE);
+        WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    }
+}
+    
+} // namespace GameAway
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+namespace GameAway {
+
+// Smooths a sparse stream of cursor positions (the sender throttles moves)
+// by emitting interpolated positions at a fixed output rate, optionally
+// dead-reckoning a little past the newest sample using recent velocity.
+// Idle (no ticks at all) whenever the cursor is at rest.
+class CursorInterpolator {
+public:
+    using MoveCallback = std::function<void(int x, int y)>;
+    
+    // Called on the output thread, right after the cursor has been moved to
+    // (or past) a sample's position, with the capture timestamp of the oldest sample
+    // not reported yet (superseded samples are folded into the next one)
+    using ShownCallback = std::function<void(uint64_t timestamp)>;
+    
+    CursorInterpolator(MoveCallback move, int outputHz, int extrapolateMs, ShownCallback shown = nullptr);
+    ~CursorInterpolator();
+    
+    // A true cursor position from the sender, captured at 'timestamp' (0 if unknown)
+    void onSample(int x, int y, uint64_t timestamp = 0);
+    
+    // Jump to the newest true position now (before a button event)
+    void snap();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    MoveCallback m_move;
+    ShownCallback m_shown;
+    std::chrono::microseconds m_period;
+    double m_extrapolateMs;
+    
+    // m_emitMutex serializes output between the tick thread and snap();
+    // take it before m_mutex
+    std::mutex m_emitMutex;
+    std::mutex m_mutex;
+    
+    // Segment currently animated: from the position shown when the sample
+    // arrived to the sample itself, over the observed sample interval
+    double m_fromX = 0, m_fromY = 0;
+    int m_toX = 0, m_toY = 0;
+    double m_velX = 0, m_velY = 0;  // Pixels per ms, for dead reckoning
+    double m_intervalMs = 16.0;
+    Clock::time_point m_segmentStart;
+    Clock::time_point m_lastSample;
+    bool m_hasSample = false;
+    bool m_active = false;
+    uint64_t m_unshownTimestamp = 0;   // Oldest sample whose position is not on screen yet
+    
+    int m_outX = 0, m_outY = 0;  // Last emitted position
+    bool m_hasOutput = false;
+    
+    HANDLE m_wakeEvent = nullptr;
+    HANDLE m_timer = nullptr;
+    std::atomic<bool> m_stopping{false};
+    std::thread m_thread;
+    
+    bool position(Clock::time_point now, int& x, int& y) const;
+    uint64_t takeShown();   // m_mutex held
+    void emit(int x, int y);
+    void outputLoop();
+};
+    
+} // namespace GameAway
@@ -0,0 +1,147 @@
+#include "gamepad_replay.hpp"
+#include "utils/logger.hpp"
+#include <winrt/Windows.Foundation.h>
+#include <winrt/Windows.Gaming.Input.h>
+#include <winrt/Windows.UI.Input.Preview.Injection.h>
+#include <Xinput.h>
+#include <string>
+
+namespace GameAway {
+
+using winrt::Windows::Gaming::Input::GamepadButtons;
+using winrt::Windows::UI::Input::Preview::Injection::InjectedInputGamepadInfo;
+using winrt::Windows::UI::Input::Preview::Injection::InputInjector;
+
+namespace {
+
+// XInput button bits as sent by the client, and their injection equivalents
+struct ButtonMapping {
+    uint16_t xinput;
+    GamepadButtons injected;
+};
+
+const ButtonMapping BUTTON_MAP[] = {
+    {XINPUT_GAMEPAD_DPAD_UP, GamepadButtons::DPadUp},
+    {XINPUT_GAMEPAD_DPAD_DOWN, GamepadButtons::DPadDown},
+    {XINPUT_GAMEPAD_DPAD_LEFT, GamepadButtons::DPadLeft},
+    {XINPUT_GAMEPAD_DPAD_RIGHT, GamepadButtons::DPadRight},
+    {XINPUT_GAMEPAD_START, GamepadButtons::Menu},
+    {XINPUT_GAMEPAD_BACK, GamepadButtons::View},
+    {XINPUT_GAMEPAD_LEFT_THUMB, GamepadButtons::LeftThumbstick},
+    {XINPUT_GAMEPAD_RIGHT_THUMB, GamepadButtons::RightThumbstick},
+    {XINPUT_GAMEPAD_LEFT_SHOULDER, GamepadButtons::LeftShoulder},
+    {XINPUT_GAMEPAD_RIGHT_SHOULDER, GamepadButtons::RightShoulder},
+    {XINPUT_GAMEPAD_A, GamepadButtons::A},
+    {XINPUT_GAMEPAD_B, GamepadButtons::B},
+    {XINPUT_GAMEPAD_X, GamepadButtons::X},
+    {XINPUT_GAMEPAD_Y, GamepadButtons::Y},
+};
+
+GamepadButtons mapButtons(uint16_t xinput) {
+    GamepadButtons buttons = GamepadButtons::None;
+    for (const auto& mapping : BUTTON_MAP) {
+        if (xinput & mapping.xinput) {
+            buttons = buttons | mapping.injected;
+        }
+    }
+    return buttons;
+}
+
+// Sticks are -1..1 and triggers 0..1 on the injection side
+double normalizeStick(int16_t value) {
+    return value < 0 ? value / 32768.0 : value / 32767.0;
+}
+
+double normalizeTrigger(uint8_t value) {
+    return value / 255.0;
+}
+
+} // namespace
+
+struct GamepadReplay::Injector {
+    InputInjector injector{nullptr};
+};
+
+GamepadReplay::GamepadReplay() = default;
+
+GamepadReplay::~GamepadReplay() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_injector) return;
+    
+    try {
+        m_injector->injector.UninitializeGamepadInjection();
+    } catch (...) {
+        // Shutting down either way
+    }
+}
+
+bool GamepadReplay::replay(const InputEvent& event) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if (event.type == InputEventType::GamepadButtons) {
+        m_state.buttons = event.gamepad.buttons;
+    } else if (event.type == InputEventType::GamepadAxes) {
+        uint16_t buttons = m_state.buttons;
+        m_state = event.gamepad;
+        m_state.buttons = buttons;
+    } else {
+        return false;
+    }
+    
+    return inject();
+}
+
+void GamepadReplay::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = GamepadState{};
+    
+    // Nothing to release on a controller that was never created
+    if (m_injector) {
+        inject();
+    }
+}
+
+bool GamepadReplay::inject() {
+    if (m_unavailable) return false;
+    
+    try {
+        if (!m_injector) {
+            // Injection is per thread apartment; join the process-wide MTA
+            try {
+                winrt::init_apartment(winrt::apartment_type::multi_threaded);
+            } catch (...) {
+                // Already initialized on this thread
+            }
+            
+            InputInjector injector = InputInjector::TryCreate();
+            if (!injector) {
+                m_unavailable = true;
+                logWarn("Gamepad injection unavailable - gamepad input ignored");
+                return false;
+            }
+            injector.InitializeGamepadInjection();
+            
+            m_injector = std::make_unique<Injector>();
+            m_injector->injector = injector;
+            logInfo("Virtual gamepad created");
+        }
+        
+        InjectedInputGamepadInfo info;
+        info.Buttons(mapButtons(m_state.buttons));
+        info.LeftTrigger(normalizeTrigger(m_state.leftTrigger));
+        info.RightTrigger(normalizeTrigger(m_state.rightTrigger));
+        info.LeftThumbstickX(normalizeStick(m_state.thumbLX));
+        info.LeftThumbstickY(normalizeStick(m_state.thumbLY));
+        info.RightThumbstickX(normalizeStick(m_state.thumbRX));
+        info.RightThumbstickY(normalizeStick(m_state.thumbRY));
+        m_injector->injector.InjectGamepadInput(info);
+        return true;
+    } catch (const winrt::hresult_error& e) {
+        m_unavailable = true;
+        m_injector.reset();
+        logWarn("Gamepad injection failed: " + winrt::to_string(e.message()) + " - gamepad input ignored");
+        return false;
+    }
+}
+
+} // namespace GameAway
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "client/input_hook.hpp"
+#include <memory>
+#include <mutex>
+
+namespace GameAway {
+
+// Drives a virtual gamepad on this machine from forwarded gamepad events,
+// through the Windows input injection API. The virtual controller is only
+// created once the first gamepad event arrives. Button and axis events each
+// update their half of one merged state, which is injected whole.
+// Thread-safe.
+class GamepadReplay {
+public:
+    GamepadReplay();
+    ~GamepadReplay();
+    
+    // Apply a GamepadButtons or GamepadAxes event
+    bool replay(const InputEvent& event);
+    
+    // Release everything (client gone or paused)
+    void reset();
+
+private:
+    struct Injector;   // WinRT types stay out of this header
+    
+    std::mutex m_mutex;
+    std::unique_ptr<Injector> m_injector;
+    GamepadState m_state{};
+    bool m_unavailable = false;   // Creation failed once; not retried
+    
+    bool inject();
+};
+
+} // namespace GameAway
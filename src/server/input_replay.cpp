@@ -1,23 +1,95 @@
 #include "input_replay.hpp"
+#include "utils/token.hpp"
 #include <Windows.h>
+#include <algorithm>
+#include <cmath>
 
 namespace GameAway {
 
-InputReplay::InputReplay() {
-    // Get virtual screen dimensions (handles multi-monitor)
-    m_screenWidth = GetSystemMetrics(SM_CXVIRTUALSCREEN);
-    m_screenHeight = GetSystemMetrics(SM_CYVIRTUALSCREEN);
-    m_screenLeft = GetSystemMetrics(SM_XVIRTUALSCREEN);
-    m_screenTop = GetSystemMetrics(SM_YVIRTUALSCREEN);
-    
-    // Fallback to primary monitor if virtual screen fails
-    if (m_screenWidth == 0) m_screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    if (m_screenHeight == 0) m_screenHeight = GetSystemMetrics(SM_CYSCREEN);
+InputReplay::InputReplay() : m_marker(getInjectionMarker()) {
+    refreshLocalLayout();
 }
 
 void InputReplay::setScreenSize(int width, int height) {
-    m_screenWidth = width;
-    m_screenHeight = height;
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_localLayout = {{0, 0, width, height}};
+    rebuildTransforms();
+}
+
+void InputReplay::setSourceLayout(const std::vector<MonitorRect>& monitors) {
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_sourceLayout = monitors;
+    rebuildTransforms();
+}
+
+void InputReplay::refreshLocalLayout() {
+    std::vector<MonitorRect> monitors = queryMonitorLayout();
+    
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    m_localLayout = std::move(monitors);
+    rebuildTransforms();
+}
+
+void InputReplay::rebuildTransforms() {
+    m_transforms.clear();
+    m_lastTransform = 0;
+    
+    if (m_localLayout.empty()) return;
+    
+    const auto& source = m_sourceLayout.empty() ? m_localLayout : m_sourceLayout;
+    MonitorRect desk = boundingRect(m_localLayout);
+    double unitsX = 65535.0 / std::max(1, desk.width - 1);
+    double unitsY = 65535.0 / std::max(1, desk.height - 1);
+    
+    for (size_t i = 0; i < source.size(); ++i) {
+        const MonitorRect& src = source[i];
+        // Extra sender monitors share the receiver's last one
+        const MonitorRect& dst = m_localLayout[std::min(i, m_localLayout.size() - 1)];
+        
+        if (src.width <= 0 || src.height <= 0) continue;
+        
+        // Scale covers both resolution/DPI differences and the pixel-to-unit conversion
+        MonitorTransform t;
+        t.srcLeft = src.left;
+        t.srcTop = src.top;
+        t.srcRight = src.left + src.width;
+        t.srcBottom = src.top + src.height;
+        t.mulX = std::llround(static_cast<double>(dst.width) / src.width * unitsX * 65536.0);
+        t.mulY = std::llround(static_cast<double>(dst.height) / src.height * unitsY * 65536.0);
+        t.addX = std::llround((dst.left - desk.left) * unitsX);
+        t.addY = std::llround((dst.top - desk.top) * unitsY);
+        m_transforms.push_back(t);
+    }
+}
+
+void InputReplay::mapToAbsolute(int x, int y, LONG& dx, LONG& dy) {
+    std::lock_guard<std::mutex> lock(m_layoutMutex);
+    
+    if (m_transforms.empty()) {
+        dx = dy = 0;
+        return;
+    }
+    
+    auto contains = [x, y](const MonitorTransform& t) {
+        return x >= t.srcLeft && x < t.srcRight && y >= t.srcTop && y < t.srcBottom;
+    };
+    
+    // Positions off every monitor keep using the last one and get clamped
+    if (!contains(m_transforms[m_lastTransform])) {
+        for (size_t i = 0; i < m_transforms.size(); ++i) {
+            if (contains(m_transforms[i])) {
+                m_lastTransform = i;
+                break;
+            }
+        }
+    }
+    
+    const MonitorTransform& t = m_transforms[m_lastTransform];
+    int64_t absX = ((static_cast<int64_t>(x - t.srcLeft) * t.mulX) >> 16) + t.addX;
+    int64_t absY = ((static_cast<int64_t>(y - t.srcTop) * t.mulY) >> 16) + t.addY;
+    
+    dx = static_cast<LONG>(std::clamp<int64_t>(absX, 0, 65535));
+    dy = static_cast<LONG>(std::clamp<int64_t>(absY, 0, 65535));
 }
 
 bool InputReplay::replay(const InputEvent& event) {
@@ -47,13 +119,8 @@ bool InputReplay::replay(const InputEvent& event) {
         case InputEventType::MouseMove:
         {
             input.type = INPUT_MOUSE;
-            // Convert to absolute coordinates (0-65535 range) with proper rounding
-            // Account for virtual screen offset (multi-monitor)
-            int adjustedX = event.x - m_screenLeft;
-            int adjustedY = event.y - m_screenTop;
-            
-            input.mi.dx = static_cast<LONG>(((adjustedX * 65536) / m_screenWidth) + 1);
-            input.mi.dy = static_cast<LONG>(((adjustedY * 65536) / m_screenHeight) + 1);
+            // Convert to absolute virtual-desktop coordinates (0-65535 range)
+            mapToAbsolute(event.x, event.y, input.mi.dx, input.mi.dy);
             input.mi.dwFlags = MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE | MOUSEEVENTF_VIRTUALDESK;
             break;
         }
@@ -87,10 +154,119 @@ bool InputReplay::replay(const InputEvent& event) {
             input.mi.mouseData = static_cast<DWORD>(event.wheelDelta);
             break;
         }
+        
+        default:
+            // Gamepad events go to GamepadReplay
+            return false;
+    }
+    
+    // Tag the event so a capture hook on this machine does not send it back
+    if (input.type == INPUT_KEYBOARD) {
+        input.ki.dwExtraInfo = m_marker;
+    } else {
+        input.mi.dwExtraInfo = m_marker;
     }
     
     UINT result = SendInput(1, &input, sizeof(INPUT));
-    return result == 1;
+    if (result != 1) return false;
+    
+    trackHeld(event);
+    return true;
+}
+
+void InputReplay::trackHeld(const InputEvent& event) {
+    std::lock_guard<std::mutex> lock(m_heldMutex);
+    
+    bool down = event.type == InputEventType::KeyDown || event.type == InputEventType::MouseButtonDown;
+    if (event.type == InputEventType::KeyDown || event.type == InputEventType::KeyUp) {
+        size_t key = (event.scanCode & 0xFF) | ((event.scanCode & 0xE000) ? 0x100 : 0);
+        m_heldKeys.set(key, down);
+    } else if ((event.type == InputEventType::MouseButtonDown || event.type == InputEventType::MouseButtonUp) &&
+               event.button >= 0 && event.button < static_cast<int>(m_heldButtons.size())) {
+        m_heldButtons.set(event.button, down);
+    }
+}
+
+void InputReplay::releaseHeld() {
+    std::bitset<512> keys;
+    std::bitset<3> buttons;
+    {
+        std::lock_guard<std::mutex> lock(m_heldMutex);
+        keys = m_heldKeys;
+        buttons = m_heldButtons;
+    }
+    
+    for (size_t key = 0; key < keys.size(); key++) {
+        if (!keys.test(key)) continue;
+        
+        InputEvent up{};
+        up.type = InputEventType::KeyUp;
+        up.scanCode = static_cast<int>((key & 0xFF) | ((key & 0x100) ? 0xE000 : 0));
+        replay(up);
+    }
+    
+    for (size_t button = 0; button < buttons.size(); button++) {
+        if (!buttons.test(button)) continue;
+        
+        InputEvent up{};
+        up.type = InputEventType::MouseButtonUp;
+        up.button = static_cast<int>(button);
+        replay(up);
+    }
+}
+
+bool InputReplay::typeText(const std::wstring& text, size_t& offset, size_t maxChars) {
+    size_t end = std::min(text.size(), offset + maxChars);
+    
+    // Keep surrogate pairs in one batch
+    if (end < text.size() && end > offset && text[end - 1] >= 0xD800 && text[end - 1] <= 0xDBFF) {
+        --end;
+    }
+    
+    std::vector<INPUT> inputs;
+    inputs.reserve((end - offset) * 2);
+    
+    for (size_t i = offset; i < end; ++i) {
+        wchar_t c = text[i];
+        
+        // CRLF and a lone CR are one Enter
+        if (c == L'\r') {
+            if (i + 1 < text.size() && text[i + 1] == L'\n') continue;
+            c = L'\n';
+        }
+        
+        INPUT down{};
+        down.type = INPUT_KEYBOARD;
+        down.ki.dwExtraInfo = m_marker;
+        
+        // Many apps ignore Unicode packets for Enter and Tab, so press the real keys
+        if (c == L'\n' || c == L'\t') {
+            down.ki.wVk = (c == L'\n') ? VK_RETURN : VK_TAB;
+        } else {
+            down.ki.wScan = static_cast<WORD>(c);
+            down.ki.dwFlags = KEYEVENTF_UNICODE;
+        }
+        
+        INPUT up = down;
+        up.ki.dwFlags |= KEYEVENTF_KEYUP;
+        
+        inputs.push_back(down);
+        inputs.push_back(up);
+    }
+    offset = end;
+    
+    if (inputs.empty()) return true;
+    
+    UINT result = SendInput(static_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
+    return result == inputs.size();
+}
+
+bool InputReplay::shortcutModifiersHeld() {
+    return (GetAsyncKeyState(VK_SHIFT) & 0x8000) ||
+           (GetAsyncKeyState(VK_CONTROL) & 0x8000) ||
+           (GetAsyncKeyState(VK_MENU) & 0x8000) ||
+           (GetAsyncKeyState(VK_LWIN) & 0x8000) ||
+           (GetAsyncKeyState(VK_RWIN) & 0x8000);
 }
 
 } // namespace GameAway
@@ -1,6 +1,11 @@
 #pragma once
 
 #include "client/input_hook.hpp"
+#include "utils/monitor_layout.hpp"
+#include <bitset>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace GameAway {
 
@@ -12,14 +17,55 @@ public:
     // Replay an input event on this machine
     bool replay(const InputEvent& event);
     
+    // Release every key and mouse button replayed as down and not yet up,
+    // e.g. when the client vanished while holding them
+    void releaseHeld();
+    
+    // Type text from 'offset' as Unicode keystrokes, at most maxChars
+    // characters in one SendInput call, and advance 'offset' past them
+    bool typeText(const std::wstring& text, size_t& offset, size_t maxChars);
+    
+    // Shift, Ctrl, Alt or Win is down, so typed text would trigger shortcuts,
+    // or arrive as Shift+Tab and Shift+Enter
+    static bool shortcutModifiersHeld();
+    
     // Set screen resolution for coordinate scaling
     void setScreenSize(int width, int height);
     
+    // Monitor layout of the sending machine. Mouse positions are mapped
+    // monitor-to-monitor by index; without a layout both machines are
+    // assumed to share the same geometry.
+    void setSourceLayout(const std::vector<MonitorRect>& monitors);
+    
+    // Re-read this machine's monitors (call on display changes)
+    void refreshLocalLayout();
+    
 private:
-    int m_screenWidth = 1920;
-    int m_screenHeight = 1080;
-    int m_screenLeft = 0;   // Virtual screen left offset (multi-monitor)
-    int m_screenTop = 0;    // Virtual screen top offset (multi-monitor)
+    ULONG_PTR m_marker;  // dwExtraInfo tag for loop detection
+    
+    // What replay() left pressed; it runs on the network loop and the
+    // playout thread, so this has its own lock
+    std::mutex m_heldMutex;
+    std::bitset<512> m_heldKeys;   // By scan code, extended keys in the upper half
+    std::bitset<3> m_heldButtons;
+    
+    // Maps one sender monitor to 0-65535 absolute virtual-desktop units:
+    // abs = ((pos - srcOrigin) * mul >> 16) + add
+    struct MonitorTransform {
+        int srcLeft, srcTop, srcRight, srcBottom;
+        int64_t mulX, mulY;
+        int64_t addX, addY;
+    };
+    
+    std::mutex m_layoutMutex;
+    std::vector<MonitorRect> m_sourceLayout;
+    std::vector<MonitorRect> m_localLayout;
+    std::vector<MonitorTransform> m_transforms;
+    size_t m_lastTransform = 0;  // The cursor usually stays on one monitor
+    
+    void trackHeld(const InputEvent& event);
+    void rebuildTransforms();
+    void mapToAbsolute(int x, int y, LONG& dx, LONG& dy);
 };
 
 } // namespace GameAway
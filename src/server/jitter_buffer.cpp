@@ -0,0 +1,143 @@
+#include "jitter_buffer.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace GameAway {
+
+JitterBuffer::JitterBuffer(ReplayCallback replay) : m_replay(std::move(replay)) {
+    m_targetDelayMs.store(PLAYOUT_MIN_DELAY_MS);
+    m_thread = std::thread(&JitterBuffer::playoutLoop, this);
+}
+
+JitterBuffer::~JitterBuffer() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void JitterBuffer::push(const InputEvent& event) {
+    bool discrete = event.type != InputEventType::MouseMove && event.type != InputEventType::GamepadAxes;
+    
+    if (discrete && m_bypassDiscrete.load()) {
+        std::lock_guard<std::mutex> replayLock(m_replayMutex);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            schedule(event);  // Still feeds the clock/jitter estimate
+            drainLocked(lock);
+        }
+        m_replay(event);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back({schedule(event), packInputEvent(event)});
+        m_newestTimestamp = event.timestamp;
+    }
+    m_cv.notify_all();
+}
+
+void JitterBuffer::flush() {
+    std::lock_guard<std::mutex> replayLock(m_replayMutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    drainLocked(lock);
+}
+
+void JitterBuffer::reset() {
+    flush();
+    
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_offsetWindow.clear();
+    m_jitterMs = 0.0;
+    m_lastDue = Clock::time_point();
+    m_targetDelayMs.store(PLAYOUT_MIN_DELAY_MS);
+}
+
+void JitterBuffer::drainLocked(std::unique_lock<std::mutex>& lock) {
+    std::deque<Scheduled> pending;
+    pending.swap(m_queue);
+    uint64_t referenceMs = m_newestTimestamp;
+    
+    lock.unlock();
+    for (const auto& entry : pending) {
+        m_replay(unpackInputEvent(entry.event, referenceMs));
+    }
+    lock.lock();
+}
+
+JitterBuffer::Clock::time_point JitterBuffer::schedule(const InputEvent& event) {
+    Clock::time_point now = Clock::now();
+    int64_t arrivalMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        now.time_since_epoch()).count();
+    int64_t offsetMs = arrivalMs - static_cast<int64_t>(event.timestamp);
+    
+    // Windowed minimum (monotonic deque): the least-delayed recent event
+    // approximates the clock offset plus base network latency, and the
+    // window lets it follow clock drift and route changes
+    while (!m_offsetWindow.empty() && m_offsetWindow.back().offsetMs >= offsetMs) {
+        m_offsetWindow.pop_back();
+    }
+    m_offsetWindow.push_back({arrivalMs, offsetMs});
+    while (m_offsetWindow.front().arrivalMs < arrivalMs - PLAYOUT_OFFSET_WINDOW_MS) {
+        m_offsetWindow.pop_front();
+    }
+    int64_t baseOffsetMs = m_offsetWindow.front().offsetMs;
+    
+    // Smoothed delay variation above the base, as in RFC 3550
+    double variation = static_cast<double>(offsetMs - baseOffsetMs);
+    m_jitterMs += (variation - m_jitterMs) / 16.0;
+    
+    int target = static_cast<int>(m_jitterMs * PLAYOUT_JITTER_MULTIPLIER) + 1;
+    target = std::clamp(target, PLAYOUT_MIN_DELAY_MS, PLAYOUT_MAX_DELAY_MS);
+    m_targetDelayMs.store(target);
+    
+    // Playout = capture time mapped onto our clock, plus the target delay.
+    // Never earlier than the previous event, so order is preserved.
+    int64_t dueMs = static_cast<int64_t>(event.timestamp) + baseOffsetMs + target;
+    Clock::time_point due = Clock::time_point(std::chrono::milliseconds(dueMs));
+    due = std::max(due, m_lastDue);
+    due = std::min(due, now + std::chrono::milliseconds(PLAYOUT_MAX_DELAY_MS));
+    m_lastDue = due;
+    
+    return due;
+}
+
+void JitterBuffer::playoutLoop() {
+    while (true) {
+        std::unique_lock<std::mutex> replayLock(m_replayMutex);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        
+        if (m_stopping) break;
+        
+        if (m_queue.empty()) {
+            // Don't hold the replay lock while idle; flushes need it
+            replayLock.unlock();
+            m_cv.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            continue;
+        }
+        
+        Clock::time_point due = m_queue.front().due;
+        if (Clock::now() < due) {
+            replayLock.unlock();
+            m_cv.wait_until(lock, due, [this, due] {
+                return m_stopping || m_queue.empty() || m_queue.front().due < due;
+            });
+            continue;
+        }
+        
+        InputEvent event = unpackInputEvent(m_queue.front().event, m_newestTimestamp);
+        m_queue.pop_front();
+        lock.unlock();
+        
+        m_replay(event);
+    }
+}
+
+} // namespace GameAway
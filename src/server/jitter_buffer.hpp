@@ -0,0 +1,78 @@
+#pragma once
+
+#include "client/input_hook.hpp"
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <chrono>
+
+namespace GameAway {
+
+// Receiver-side playout scheduler. Events are replayed at their original
+// relative spacing (from the sender's capture timestamps) after a small
+// delay that adapts to the observed network jitter, so bursts and gaps in
+// arrival do not show up as uneven cursor motion.
+class JitterBuffer {
+public:
+    using ReplayCallback = std::function<void(const InputEvent&)>;
+    
+    explicit JitterBuffer(ReplayCallback replay);
+    ~JitterBuffer();
+    
+    // Key, button and wheel events (and gamepad buttons) skip the delay
+    // (queued moves are flushed first so clicks still land where they should)
+    void setBypassDiscrete(bool bypass) { m_bypassDiscrete.store(bypass); }
+    
+    // Queue an event for playout (called from the network thread)
+    void push(const InputEvent& event);
+    
+    // Replay everything queued right now
+    void flush();
+    
+    // Forget clock and jitter estimates (new session)
+    void reset();
+    
+    // Current adaptive playout delay
+    int getTargetDelayMs() const { return m_targetDelayMs.load(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    struct Scheduled {
+        Clock::time_point due;
+        PackedInputEvent event;
+    };
+    
+    struct OffsetSample {
+        int64_t arrivalMs;
+        int64_t offsetMs;
+    };
+    
+    ReplayCallback m_replay;
+    std::atomic<bool> m_bypassDiscrete{true};
+    std::atomic<int> m_targetDelayMs{0};
+    
+    // m_replayMutex serializes replays between the playout thread and
+    // flushes from the network thread; take it before m_mutex
+    std::mutex m_replayMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Scheduled> m_queue;
+    uint64_t m_newestTimestamp = 0;   // Reference for unpacking queued events
+    bool m_stopping = false;
+    std::thread m_thread;
+    
+    // Clock offset estimate: windowed minimum of (local arrival - sender timestamp)
+    std::deque<OffsetSample> m_offsetWindow;
+    double m_jitterMs = 0.0;
+    Clock::time_point m_lastDue;
+    
+    Clock::time_point schedule(const InputEvent& event);
+    void playoutLoop();
+    void drainLocked(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace GameAway
@@ -1,14 +1,178 @@
 #include "server.hpp"
 #include "config.hpp"
+#include "utils/token.hpp"
+#include "utils/shared_memory_transport.hpp"
+#include "utils/logger.hpp"
+#include "utils/alloc_counter.hpp"
 #include <nlohmann/json.hpp>
-#include <iostream>
+#include <fstream>
+#include <algorithm>
 
 using json = nlohmann::json;
 
 namespace GameAway {
 
+namespace {
+
+// Keys a held press should not repeat
+bool isModifierKey(int vk) {
+    switch (vk) {
+        case VK_SHIFT: case VK_LSHIFT: case VK_RSHIFT:
+        case VK_CONTROL: case VK_LCONTROL: case VK_RCONTROL:
+        case VK_MENU: case VK_LMENU: case VK_RMENU:
+        case VK_LWIN: case VK_RWIN:
+        case VK_CAPITAL: case VK_NUMLOCK: case VK_SCROLL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Finds the type and "d" strings of a frame the way the client writes them
+// (compact, no escapes) without parsing it. False means use the JSON parser.
+bool scanFrame(std::string_view frame, std::string_view& type, std::string_view& data) {
+    auto member = [&frame](std::string_view key, std::string_view& value) {
+        size_t start = frame.find(key);
+        if (start == std::string_view::npos) return false;
+        start += key.size();
+        
+        size_t end = frame.find('"', start);
+        if (end == std::string_view::npos) return false;
+        
+        value = frame.substr(start, end - start);
+        return value.find('\\') == std::string_view::npos;
+    };
+    
+    return member("\"type\":\"", type) && member("\"d\":\"", data);
+}
+
+// Reads the flat object the client's serializeInputEvent writes: integer
+// members plus the optional "gp" array. Anything else returns false, and
+// the caller falls back to parseInputEvent.
+bool readInputEvent(std::string_view text, InputEvent& event, uint64_t& seq) {
+    size_t pos = 0;
+    
+    auto next = [&](char c) {
+        if (pos < text.size() && text[pos] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    };
+    
+    auto number = [&](int64_t& value) {
+        bool negative = next('-');
+        size_t start = pos;
+        uint64_t magnitude = 0;
+        
+        // 18 digits cannot overflow; longer numbers fail on the next check
+        while (pos < text.size() && pos - start < 18 && text[pos] >= '0' && text[pos] <= '9') {
+            magnitude = magnitude * 10 + (text[pos++] - '0');
+        }
+        
+        value = negative ? -static_cast<int64_t>(magnitude) : static_cast<int64_t>(magnitude);
+        return pos > start;
+    };
+    
+    event = InputEvent{};
+    seq = 0;
+    bool hasType = false;
+    
+    if (!next('{')) return false;
+    
+    while (!next('}')) {
+        if (!next('"')) return false;
+        size_t keyEnd = text.find('"', pos);
+        if (keyEnd == std::string_view::npos) return false;
+        std::string_view key = text.substr(pos, keyEnd - pos);
+        pos = keyEnd + 1;
+        if (!next(':')) return false;
+        
+        if (key == "gp") {
+            int64_t gp[7];
+            if (!next('[')) return false;
+            for (int i = 0; i < 7; i++) {
+                if ((i > 0 && !next(',')) || !number(gp[i])) return false;
+            }
+            if (!next(']')) return false;
+            
+            event.gamepad.buttons = static_cast<uint16_t>(gp[0]);
+            event.gamepad.leftTrigger = static_cast<uint8_t>(gp[1]);
+            event.gamepad.rightTrigger = static_cast<uint8_t>(gp[2]);
+            event.gamepad.thumbLX = static_cast<int16_t>(gp[3]);
+            event.gamepad.thumbLY = static_cast<int16_t>(gp[4]);
+            event.gamepad.thumbRX = static_cast<int16_t>(gp[5]);
+            event.gamepad.thumbRY = static_cast<int16_t>(gp[6]);
+        } else {
+            int64_t value = 0;
+            if (!number(value)) return false;
+            
+            if (key == "t") {
+                event.type = static_cast<InputEventType>(value);
+                hasType = true;
+            }
+            else if (key == "vk") event.vkCode = static_cast<int>(value);
+            else if (key == "sc") event.scanCode = static_cast<int>(value);
+            else if (key == "x") event.x = static_cast<int>(value);
+            else if (key == "y") event.y = static_cast<int>(value);
+            else if (key == "btn") event.button = static_cast<int>(value);
+            else if (key == "wd") event.wheelDelta = static_cast<int>(value);
+            else if (key == "ts") event.timestamp = static_cast<uint64_t>(value);
+            else if (key == "sq") seq = static_cast<uint64_t>(value);
+        }
+        
+        if (!next(',') && (pos >= text.size() || text[pos] != '}')) return false;
+    }
+    
+    return hasType && pos == text.size();
+}
+    
+} // namespace
+
+ClientSession::ClientSession() : m_inbox(SERVER_INBOX_FRAMES) {
+}
+
+bool ClientSession::pushFrame(const std::string& frame, const std::atomic<bool>& running) {
+    std::unique_lock<std::mutex> lock(m_inboxMutex);
+    
+    // Woken by popFrame; the timeout only rechecks for shutdown
+    while (m_inboxCount == m_inbox.size()) {
+        if (!running.load()) return false;
+        m_inboxSpace.wait_for(lock, std::chrono::milliseconds(SERVER_INBOX_WAIT_MS));
+    }
+    
+    m_inbox[(m_inboxHead + m_inboxCount) % m_inbox.size()].assign(frame);
+    m_inboxCount++;
+    return true;
+}
+
+bool ClientSession::send(const std::string& message) {
+    lastSent = std::chrono::steady_clock::now();
+    return transport->send(message);
+}
+
+bool ClientSession::popFrame(std::string& frame) {
+    std::lock_guard<std::mutex> lock(m_inboxMutex);
+    if (m_inboxCount == 0) return false;
+    
+    // The slot takes the caller's old buffer, so no capacity is lost
+    frame.swap(m_inbox[m_inboxHead]);
+    m_inboxHead = (m_inboxHead + 1) % m_inbox.size();
+    m_inboxCount--;
+    m_inboxSpace.notify_one();
+    return true;
+}
+
 Server::Server(uint16_t port) : m_port(port) {
     m_replay = std::make_unique<InputReplay>();
+    m_gamepad = std::make_unique<GamepadReplay>();
+    setCursorInterpolation(CURSOR_OUTPUT_HZ, CURSOR_EXTRAPOLATE_MS);
+    setPlayoutSmoothing(PLAYOUT_SMOOTHING, PLAYOUT_BYPASS_DISCRETE);
+    
+    // Room for every socket plus the two links, so adding never reallocates
+    m_ready.reserve(SERVER_MAX_CONNECTIONS + 2);
+    m_draining.reserve(SERVER_MAX_CONNECTIONS + 2);
+    m_loop.setSignalHandler([this]() { drainInboxes(); });
 }
 
 Server::~Server() {
@@ -24,30 +188,179 @@ void Server::setApprovalCallback(ApprovalCallback callback) {
     m_approvalCallback = std::move(callback);
 }
 
+void Server::setChangeCallback(ChangeCallback callback) {
+    m_changeCallback = std::move(callback);
+}
+
+void Server::notifyChange() {
+    if (m_changeCallback) {
+        m_changeCallback();
+    }
+}
+
+bool Server::nextApprovalRequest(ApprovalRequest& request) {
+    std::lock_guard<std::mutex> lock(m_approvalMutex);
+    
+    for (auto& pending : m_pendingApprovals) {
+        if (!pending.handedOut) {
+            pending.handedOut = true;
+            request = pending.request;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void Server::answerApproval(uint64_t id, bool approved, bool remember) {
+    // The decision touches session state, which belongs to the network loop
+    m_loop.post([this, id, approved, remember]() {
+        handleApproval(id, approved, remember);
+    });
+}
+
+void Server::handleApproval(uint64_t id, bool approved, bool remember) {
+    PendingApproval pending;
+    {
+        std::lock_guard<std::mutex> lock(m_approvalMutex);
+        
+        auto it = std::find_if(m_pendingApprovals.begin(), m_pendingApprovals.end(),
+            [id](const PendingApproval& p) { return p.request.id == id; });
+        
+        // The client may have given up and closed while the prompt was open
+        if (it == m_pendingApprovals.end()) return;
+        
+        pending = std::move(*it);
+        m_pendingApprovals.erase(it);
+        
+        if (approved && remember && !pending.request.clientId.empty()) {
+            m_trustedClients.insert(pending.request.clientId);
+            saveTrustedClients();
+        }
+    }
+    
+    if (approved) {
+        acceptConnection(pending.session, false);
+        logInfo("Connection accepted");
+    } else {
+        rejectConnection(pending.session, "Rejected by user");
+        logInfo("Connection rejected by user");
+    }
+}
+
+void Server::loadTrustedClients(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_approvalMutex);
+    
+    m_trustedClientsPath = path;
+    m_trustedClients.clear();
+    
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty()) m_trustedClients.insert(line);
+    }
+}
+
+void Server::saveTrustedClients() {
+    if (m_trustedClientsPath.empty()) return;
+    
+    std::ofstream out(m_trustedClientsPath, std::ios::trunc);
+    for (const auto& clientId : m_trustedClients) {
+        out << clientId << "\n";
+    }
+}
+
+void Server::setRelay(const std::string& host, uint16_t port) {
+    m_relayHost = host;
+    m_relayPort = port;
+}
+
 bool Server::start() {
     if (m_running.load() || !m_crypto || !m_crypto->isValid()) {
         return false;
     }
     
-    m_server = std::make_unique<ix::WebSocketServer>(m_port, "0.0.0.0");
+    if (!m_relayHost.empty()) {
+        m_pairingId = getPairingId(m_token);
+        m_relaySocket = std::make_shared<ix::WebSocket>();
+        m_relaySocket->setUrl("ws://" + m_relayHost + ":" + std::to_string(m_relayPort));
+        
+        // The relay closes us whenever our client leaves; come straight back
+        m_relaySocket->enableAutomaticReconnection();
+        m_relaySocket->setMaxWaitBetweenReconnectionRetries(RECONNECT_MAX_DELAY_MS);
+        
+        // While we wait for a client nothing else shows the relay we are alive
+        m_relaySocket->setPingInterval(RELAY_PING_INTERVAL_S);
+        
+        m_relayLink = std::make_shared<WebSocketTransport>(m_relaySocket);
+        m_relayLink->setEventCallback([this](TransportEvent event, const std::string& data) {
+            if (event == TransportEvent::Open) {
+                json pair;
+                pair["type"] = MsgType::PAIR;
+                pair["id"] = m_pairingId;
+                pair["role"] = "host";
+                m_relayLink->send(pair.dump());
+                logInfo("Connected to relay, waiting for client");
+            }
+            dispatchLinkEvent(m_relayLink, m_relaySession, m_relayIncoming, event, data);
+        });
+        
+        m_loopThread = std::thread([this]() { m_loop.run(); });
+        m_relayLink->start();
+        m_running.store(true);
+        
+        m_displayWatcher.start([this]() {
+            m_replay->refreshLocalLayout();
+        });
+        
+        return true;
+    }
+    
+    m_server = std::make_unique<ix::WebSocketServer>(m_port, "0.0.0.0", SERVER_LISTEN_BACKLOG, SERVER_MAX_CONNECTIONS);
+    
+    m_server->setConnectionStateFactory([]() {
+        return std::make_shared<ClientSession>();
+    });
     
     m_server->setOnClientMessageCallback(
         [this](std::shared_ptr<ix::ConnectionState> connectionState,
                ix::WebSocket& webSocket,
                const ix::WebSocketMessagePtr& msg) {
-            handleMessage(connectionState, webSocket, msg);
+            dispatchMessage(connectionState, webSocket, msg);
         }
     );
     
     auto result = m_server->listen();
     if (!result.first) {
-        std::cerr << "Error: " << result.second << std::endl;
+        logError("Failed to listen: " + result.second);
         return false;
     }
     
+    m_loopThread = std::thread([this]() { m_loop.run(); });
     m_server->start();
     m_running.store(true);
     
+    // Clients on this machine can skip TCP entirely
+    m_localLink = std::make_shared<SharedMemoryTransport>(SharedMemoryTransport::Role::Server, m_port);
+    m_localLink->setEventCallback([this](TransportEvent event, const std::string& data) {
+        if (event == TransportEvent::Open) {
+            logInfo("Client connected (shared memory)");
+        } else if (event == TransportEvent::Error) {
+            logWarn("Local transport unavailable: " + data);
+        }
+        dispatchLinkEvent(m_localLink, m_localSession, m_localIncoming, event, data);
+    });
+    m_localLink->start();
+    
+    // Let clients on the LAN find us without typing an address
+    if (!m_beacon.start(m_token, m_port)) {
+        logWarn("LAN discovery unavailable");
+    }
+    
+    m_displayWatcher.start([this]() {
+        m_replay->refreshLocalLayout();
+    });
+    
     return true;
 }
 
@@ -56,12 +369,205 @@ void Server::stop() {
     
     m_running.store(false);
     
+    m_beacon.stop();
+    m_displayWatcher.stop();
+    
+    // Connection threads first, so nothing posts to the loop once it is gone
     if (m_server) {
         m_server->stop();
-        m_server.reset();
+    }
+    if (m_relayLink) {
+        m_relayLink->stop();
+    }
+    if (m_localLink) {
+        m_localLink->stop();
+    }
+    
+    m_loop.stop();
+    if (m_loopThread.joinable()) {
+        m_loopThread.join();
+    }
+    
+    m_server.reset();
+    m_relaySession.reset();
+    m_relayIncoming.reset();
+    m_relayLink.reset();
+    m_relaySocket.reset();
+    m_localSession.reset();
+    m_localIncoming.reset();
+    m_localLink.reset();
+}
+
+void Server::setPlayoutSmoothing(bool enabled, bool bypassDiscrete) {
+    if (!enabled) {
+        m_jitterBuffer.reset();
+        return;
+    }
+    
+    if (!m_jitterBuffer) {
+        m_jitterBuffer = std::make_unique<JitterBuffer>([this](const InputEvent& event) {
+            replayEvent(event);
+        });
+    }
+    m_jitterBuffer->setBypassDiscrete(bypassDiscrete);
+}
+
+void Server::setCursorInterpolation(int outputHz, int extrapolateMs) {
+    m_cursor.reset();
+    
+    if (outputHz <= 0) return;
+    
+    m_cursor = std::make_unique<CursorInterpolator>([this](int x, int y) {
+        InputEvent move{};
+        move.type = InputEventType::MouseMove;
+        move.x = x;
+        move.y = y;
+        m_replay->replay(move);
+    }, outputHz, extrapolateMs, [this](uint64_t timestamp) {
+        recordLatency(timestamp);
+    });
+}
+
+void Server::deliverEvent(const InputEvent& event) {
+    if (m_jitterBuffer) {
+        m_jitterBuffer->push(event);
+    } else {
+        replayEvent(event);
+    }
+}
+
+void Server::recordLatency(uint64_t timestamp) {
+    if (timestamp == 0) return;
+    
+    int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    m_latency.record(nowMs - static_cast<int64_t>(timestamp));
+}
+
+void Server::replayEvent(const InputEvent& event) {
+    // Latency is taken once the event is injected: here, or for moves when
+    // the interpolator has moved the cursor onto them
+    if (m_cursor) {
+        if (event.type == InputEventType::MouseMove) {
+            m_cursor->onSample(event.x, event.y, event.timestamp);
+            return;
+        }
+        
+        // Clicks must land on the true position, not an interpolated one
+        if (event.type == InputEventType::MouseButtonDown ||
+            event.type == InputEventType::MouseButtonUp ||
+            event.type == InputEventType::MouseWheel) {
+            m_cursor->snap();
+        }
+    }
+    
+    if (event.type == InputEventType::GamepadButtons || event.type == InputEventType::GamepadAxes) {
+        m_gamepad->replay(event);
+    } else {
+        m_replay->replay(event);
+    }
+    recordLatency(event.timestamp);
+}
+
+void Server::queueText(const std::string& utf8) {
+    if (utf8.empty() || utf8.size() > TEXT_MAX_BYTES) return;
+    
+    int length = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), nullptr, 0);
+    if (length <= 0) return;
+    
+    std::wstring text(static_cast<size_t>(length), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()), &text[0], length);
+    
+    // Drop what was already typed before appending
+    m_text.erase(0, m_textOffset);
+    m_textOffset = 0;
+    
+    if (m_text.size() + text.size() > TEXT_QUEUE_UNITS) {
+        logWarn("Text queue full - paste dropped");
+        return;
+    }
+    
+    if (m_text.empty()) {
+        m_textModifierDeadline = std::chrono::steady_clock::now() +
+            std::chrono::milliseconds(TEXT_MODIFIER_WAIT_MS);
+    }
+    m_text += text;
+    
+    if (!m_textScheduled) {
+        typeTextBatch();
+    }
+}
+
+void Server::typeTextBatch() {
+    m_textScheduled = false;
+    
+    if (m_paused.load()) {
+        clearText();
+        return;
+    }
+    
+    // The paste hotkey's modifiers may still be held here; typing now
+    // would turn letters into shortcuts
+    bool waiting = InputReplay::shortcutModifiersHeld() &&
+        std::chrono::steady_clock::now() < m_textModifierDeadline;
+    
+    if (!waiting) {
+        // Keystrokes queued before the text go first
+        if (m_jitterBuffer) {
+            m_jitterBuffer->flush();
+        }
+        m_replay->typeText(m_text, m_textOffset, TEXT_BATCH_CHARS);
+    }
+    
+    if (m_textOffset >= m_text.size()) {
+        clearText();
+        return;
+    }
+    
+    m_textScheduled = true;
+    m_loop.runAfter(std::chrono::milliseconds(TEXT_BATCH_INTERVAL_MS), [this]() {
+        typeTextBatch();
+    });
+}
+
+void Server::clearText() {
+    m_text.clear();
+    m_textOffset = 0;
+}
+
+void Server::trackKeyRepeat(const InputEvent& event) {
+    if (event.type == InputEventType::KeyDown) {
+        // Like a real keyboard, only the newest press repeats
+        stopKeyRepeat();
+        if (isModifierKey(event.vkCode)) return;
+        
+        m_repeatKey = event;
+        m_repeatKey.timestamp = 0;
+        uint64_t generation = m_repeatGeneration;
+        m_loop.runAfter(std::chrono::milliseconds(m_keyRepeat.delayMs), [this, generation]() {
+            repeatKey(generation);
+        });
+    }
+    else if (event.type == InputEventType::KeyUp && event.vkCode == m_repeatKey.vkCode) {
+        stopKeyRepeat();
     }
 }
 
+void Server::repeatKey(uint64_t generation) {
+    if (generation != m_repeatGeneration) return;
+    if (!m_connected.load() || m_paused.load()) return;
+    
+    m_replay->replay(m_repeatKey);
+    m_loop.runAfter(std::chrono::milliseconds(m_keyRepeat.intervalMs), [this, generation]() {
+        repeatKey(generation);
+    });
+}
+
+void Server::stopKeyRepeat() {
+    ++m_repeatGeneration;
+    m_repeatKey = InputEvent{};
+}
+
 void Server::pause() {
     m_paused.store(true);
 }
@@ -70,95 +576,498 @@ void Server::resume() {
     m_paused.store(false);
 }
 
-void Server::handleMessage(std::shared_ptr<ix::ConnectionState> connectionState,
-                           ix::WebSocket& webSocket,
-                           const ix::WebSocketMessagePtr& msg) {
+void Server::dispatchMessage(std::shared_ptr<ix::ConnectionState> connectionState,
+                             ix::WebSocket& webSocket,
+                             const ix::WebSocketMessagePtr& msg) {
+    auto session = std::static_pointer_cast<ClientSession>(connectionState);
+    
     if (msg->type == ix::WebSocketMessageType::Open) {
-        std::cout << "\n[INFO] Client connected" << std::endl;
+        // Turn floods away here, before they cost the loop anything
+        if (!m_admission.admitConnection(connectionState->getRemoteIp())) {
+            session->refused = true;
+            logWarn("Refused connection from " + connectionState->getRemoteIp());
+            webSocket.close();
+            return;
+        }
+        
+        // The server drops its reference after Close; ours keeps the socket
+        // valid for frames still queued on the loop
+        std::shared_ptr<Transport> transport;
+        for (const auto& client : m_server->getClients()) {
+            if (client.get() == &webSocket) {
+                transport = std::make_shared<WebSocketTransport>(client);
+                break;
+            }
+        }
+        
+        m_loop.post([this, session, transport,
+                     ip = connectionState->getRemoteIp(),
+                     port = connectionState->getRemotePort()]() {
+            session->transport = transport;
+            session->direct = true;
+            session->holdsAdmission = true;
+            session->remoteIp = ip;
+            session->remotePort = port;
+            handleMessage(session, TransportEvent::Open, std::string());
+            
+            // Frames that arrived before this ran waited in the inbox
+            session->open.store(true);
+            drainSession(session);
+        });
     }
     else if (msg->type == ix::WebSocketMessageType::Message) {
+        if (session->refused) return;
+        
+        if (!session->authenticated.load() &&
+            !m_admission.admitFrame(connectionState->getRemoteIp(), msg->str.size())) {
+            return;
+        }
+        
+        enqueueFrame(session, msg->str);
+    }
+    else if (msg->type == ix::WebSocketMessageType::Close) {
+        // A refused socket never reached the loop
+        if (session->refused) return;
+        
+        m_loop.post([this, session]() {
+            drainSession(session);
+            handleMessage(session, TransportEvent::Close, std::string());
+        });
+    }
+}
+
+void Server::dispatchLinkEvent(const std::shared_ptr<Transport>& link,
+                               std::shared_ptr<ClientSession>& current,
+                               std::shared_ptr<ClientSession>& incoming,
+                               TransportEvent event,
+                               const std::string& data) {
+    if (event == TransportEvent::Open) {
+        auto session = std::make_shared<ClientSession>();
+        session->transport = link;
+        session->open.store(true);   // Links have no Open handling to wait for
+        {
+            std::lock_guard<std::mutex> lock(m_incomingMutex);
+            incoming = session;
+        }
+        
+        m_loop.post([session, &current]() {
+            current = session;
+        });
+    }
+    else if (event == TransportEvent::Message) {
+        std::shared_ptr<ClientSession> session;
+        {
+            std::lock_guard<std::mutex> lock(m_incomingMutex);
+            session = incoming;
+        }
+        
+        // Outside the lock: a full inbox blocks here until the loop catches up
+        if (session) {
+            enqueueFrame(session, data);
+        }
+    }
+    else if (event == TransportEvent::Close) {
+        std::shared_ptr<ClientSession> session;
+        {
+            std::lock_guard<std::mutex> lock(m_incomingMutex);
+            session.swap(incoming);
+        }
+        if (!session) return;
+        
+        m_loop.post([this, &current, session, event, data]() {
+            drainSession(session);
+            if (!current) return;
+            
+            handleMessage(current, event, data);
+            current.reset();
+        });
+    }
+}
+
+void Server::enqueueFrame(const std::shared_ptr<ClientSession>& session, const std::string& frame) {
+    uint64_t allocations = threadAllocationCount();
+    
+    if (!session->pushFrame(frame, m_running)) {
+        // Shutting down with the loop behind; nobody will handle it
+        m_framesDropped.fetch_add(1);
+        return;
+    }
+    
+    if (!session->inboxQueued.exchange(true)) {
+        std::lock_guard<std::mutex> lock(m_readyMutex);
+        m_ready.push_back(session);
+    }
+    
+    m_receiveAllocations.fetch_add(threadAllocationCount() - allocations);
+    m_loop.signal();
+}
+
+void Server::drainInboxes() {
+    {
+        std::lock_guard<std::mutex> lock(m_readyMutex);
+        m_draining.swap(m_ready);
+    }
+    
+    for (const auto& session : m_draining) {
+        // Cleared before popping: a frame pushed from here on queues it again
+        session->inboxQueued.store(false);
+        
+        if (session->open.load()) {
+            drainSession(session);
+        }
+    }
+    m_draining.clear();
+}
+
+void Server::drainSession(const std::shared_ptr<ClientSession>& session) {
+    while (session->popFrame(m_frame)) {
+        handleMessage(session, TransportEvent::Message, m_frame);
+    }
+}
+
+void Server::handleInput(const std::shared_ptr<ClientSession>& session, std::string_view data) {
+    if (!m_connected.load() || m_paused.load()) return;
+    if (session.get() != m_activeConnection) return;
+    
+    // Frame to InputEvent in the session's buffers; counted to prove it stays off the heap
+    uint64_t allocations = threadAllocationCount();
+    uint64_t seq = 0;
+    InputEvent event{};
+    
+    bool decrypted = m_crypto->decryptInto(data, session->decoded, session->plaintext);
+    if (decrypted && !readInputEvent(session->plaintext, event, seq)) {
+        event = parseInputEvent(session->plaintext, seq);
+    }
+    
+    m_receiveAllocations.fetch_add(threadAllocationCount() - allocations);
+    m_inputFrames.fetch_add(1);
+    if (!decrypted) return;
+    
+    // Drop retransmits we already replayed before the link dropped. Moves
+    // and stick positions are checked per lane: the client holds them back
+    // while congested, so a key queued after one can reach us first with a
+    // higher seq.
+    if (seq != 0) {
+        uint64_t& lastSeq = event.type == InputEventType::MouseMove ? m_lastMoveSeq
+                          : event.type == InputEventType::GamepadAxes ? m_lastAxesSeq
+                          : m_lastSeq;
+        if (seq <= lastSeq) return;
+        lastSeq = seq;
+    }
+    
+    if (!m_filter.apply(event)) return;
+    
+    deliverEvent(event);
+    trackKeyRepeat(event);
+    m_eventsReceived.fetch_add(1);
+    notifyChange();
+}
+
+void Server::handleMessage(const std::shared_ptr<ClientSession>& session,
+                           TransportEvent event,
+                           const std::string& payload) {
+    if (event == TransportEvent::Open) {
+        logInfo("Client connected");
+        
+        // Half-open sockets would otherwise hold an admission slot forever
+        m_loop.runAfter(std::chrono::milliseconds(ADMISSION_HANDSHAKE_TIMEOUT_MS), [session]() {
+            if (session->handshake == HandshakeState::AwaitingConnect && session->transport) {
+                logWarn("Handshake timed out");
+                session->transport->close();
+            }
+        });
+    }
+    else if (event == TransportEvent::Message) {
+        if (!session->transport) return;
+        session->lastReceived = std::chrono::steady_clock::now();
+        
+        // Input frames skip the JSON parser
+        std::string_view type;
+        std::string_view data;
+        if (scanFrame(payload, type, data) &&
+            (type == MsgType::KEY || type == MsgType::MOUSE || type == MsgType::GAMEPAD)) {
+            handleInput(session, data);
+            return;
+        }
+        
         try {
-            json j = json::parse(msg->str);
-            std::string type = j["type"].get<std::string>();
+            json j = json::parse(payload);
+            std::string msgType = j["type"].get<std::string>();
             
-            if (type == MsgType::CONNECT) {
+            if (msgType == MsgType::CONNECT || msgType == MsgType::REATTACH) {
+                // Ignore repeats while this socket is already waiting or accepted
+                if (session->handshake != HandshakeState::AwaitingConnect) return;
+                
+                // Direct peers first echo a cookie, proving they see our
+                // replies, before any decryption is spent on them
+                if (session->direct &&
+                    !m_admission.verifyCookie(j.value("c", ""), session->remoteIp, session->remotePort)) {
+                    json challenge;
+                    challenge["type"] = MsgType::CHALLENGE;
+                    challenge["c"] = m_admission.issueCookie(session->remoteIp, session->remotePort);
+                    session->send(challenge.dump());
+                    return;
+                }
+                session->handshake = HandshakeState::AwaitingApproval;
+                
                 std::string encData = j["d"].get<std::string>();
                 std::string pcName;
+                std::string clientId;
+                std::string ticket;
                 
-                if (validateConnection(encData, pcName)) {
-                    bool approved = true;
-                    
-                    if (m_approvalCallback) {
-                        approved = m_approvalCallback(pcName);
-                    }
+                if (!validateConnection(encData, pcName, clientId, ticket, session->keyRepeat)) {
+                    logWarn("Invalid token - connection rejected");
+                    rejectConnection(session, "Invalid token");
+                    return;
+                }
+                
+                // Knows the token: no longer subject to pre-auth limits
+                session->authenticated.store(true);
+                releaseAdmission(session);
+                
+                // A valid ticket resumes the previous session without prompting
+                if (msgType == MsgType::REATTACH && validateTicket(ticket)) {
+                    acceptConnection(session, true);
+                    logInfo("Session resumed");
+                    return;
+                }
+                
+                ApprovalRequest request{};
+                bool busy = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_approvalMutex);
                     
-                    if (approved) {
-                        m_connected.store(true);
-                        json response;
-                        response["type"] = MsgType::ACCEPT;
-                        webSocket.send(response.dump());
-                        std::cout << "[INFO] Connection accepted" << std::endl;
-                    } else {
-                        json response;
-                        response["type"] = MsgType::REJECT;
-                        webSocket.send(response.dump());
-                        webSocket.close();
-                        std::cout << "[INFO] Connection rejected by user" << std::endl;
+                    if (m_approvalCallback && !m_trustedClients.count(clientId)) {
+                        if (m_pendingApprovals.size() >= SERVER_MAX_PENDING_APPROVALS) {
+                            busy = true;
+                        } else {
+                            // Queue for the main loop instead of blocking the network loop
+                            request = {m_nextApprovalId++, pcName, clientId};
+                            m_pendingApprovals.push_back({request, session, false});
+                        }
                     }
-                } else {
-                    std::cout << "[WARN] Invalid token - connection rejected" << std::endl;
-                    json response;
-                    response["type"] = MsgType::REJECT;
-                    response["reason"] = "Invalid token";
-                    webSocket.send(response.dump());
-                    webSocket.close();
                 }
+                
+                if (busy) {
+                    logWarn("Too many pending approvals - connection rejected");
+                    rejectConnection(session, "Server busy");
+                    return;
+                }
+                
+                if (request.id == 0) {
+                    acceptConnection(session, false);
+                    logInfo("Connection accepted (" + pcName + ")");
+                    return;
+                }
+                m_approvalCallback(request);
+            }
+            else if (msgType == MsgType::KEY || msgType == MsgType::MOUSE || msgType == MsgType::GAMEPAD) {
+                handleInput(session, j["d"].get<std::string>());
             }
-            else if (type == MsgType::KEY || type == MsgType::MOUSE) {
+            else if (msgType == MsgType::TEXT) {
                 if (!m_connected.load() || m_paused.load()) return;
+                if (session.get() != m_activeConnection) return;
                 
-                std::string encData = j["d"].get<std::string>();
-                std::string decrypted = m_crypto->decrypt(encData);
-                
+                std::string decrypted = m_crypto->decrypt(j["d"].get<std::string>());
                 if (!decrypted.empty()) {
-                    InputEvent event = parseInputEvent(decrypted);
-                    m_replay->replay(event);
+                    queueText(json::parse(decrypted)["s"].get<std::string>());
                     m_eventsReceived.fetch_add(1);
+                    notifyChange();
                 }
             }
-            else if (type == MsgType::PAUSE) {
+            else if (msgType == MsgType::LAYOUT) {
+                if (session.get() != m_activeConnection) return;
+                
+                std::string decrypted = m_crypto->decrypt(j["d"].get<std::string>());
+                if (!decrypted.empty()) {
+                    m_replay->setSourceLayout(parseLayout(decrypted));
+                }
+            }
+            else if (msgType == MsgType::PAUSE) {
                 m_paused.store(true);
-                std::cout << "\n[INFO] Paused by client" << std::endl;
+                m_gamepad->reset();
+                stopKeyRepeat();
+                logInfo("Paused by client");
+                notifyChange();
             }
-            else if (type == MsgType::RESUME) {
+            else if (msgType == MsgType::RESUME) {
                 m_paused.store(false);
-                std::cout << "\n[INFO] Resumed by client" << std::endl;
+                logInfo("Resumed by client");
+                notifyChange();
             }
             
         } catch (const std::exception& e) {
-            std::cerr << "[ERROR] " << e.what() << std::endl;
+            logError(e.what());
         }
     }
-    else if (msg->type == ix::WebSocketMessageType::Close) {
-        std::cout << "\n[INFO] Client disconnected" << std::endl;
-        m_connected.store(false);
+    else if (event == TransportEvent::Close) {
+        // Drop any approval still queued for this socket
+        {
+            std::lock_guard<std::mutex> lock(m_approvalMutex);
+            m_pendingApprovals.erase(
+                std::remove_if(m_pendingApprovals.begin(), m_pendingApprovals.end(),
+                    [&](const PendingApproval& pending) { return pending.session == session; }),
+                m_pendingApprovals.end());
+        }
+        
+        // A stale socket closing after its client already reattached is not a disconnect
+        if (session.get() == m_activeConnection) {
+            logInfo("Client disconnected");
+            dropActiveConnection();
+        }
+        
+        releaseAdmission(session);
+        session->transport.reset();
+    }
+}
+
+void Server::acceptConnection(const std::shared_ptr<ClientSession>& session, bool resumed) {
+    if (!resumed) {
+        m_sessionTicket = generateToken(SESSION_TICKET_LENGTH);
+        m_lastSeq = 0;
+        m_lastMoveSeq = 0;
+        m_lastAxesSeq = 0;
+        
+        // Clock offset of a new client is unrelated to the last one
+        if (m_jitterBuffer) {
+            m_jitterBuffer->reset();
+        }
+        m_latency.reset();
+    }
+    m_ticketExpiry = std::chrono::steady_clock::time_point::max();
+    m_keyRepeat = session->keyRepeat;
+    stopKeyRepeat();
+    
+    session->handshake = HandshakeState::Accepted;
+    session->lastReceived = std::chrono::steady_clock::now();
+    m_activeConnection = session.get();
+    m_connected.store(true);
+    
+    uint64_t generation = ++m_heartbeatGeneration;
+    m_loop.runAfter(std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS), [this, generation]() {
+        sendHeartbeat(generation);
+    });
+    
+    json ticket;
+    ticket["ticket"] = m_sessionTicket;
+    ticket["resumed"] = resumed;
+    ticket["ack"] = m_lastSeq;
+    
+    json response;
+    response["type"] = MsgType::ACCEPT;
+    response["d"] = m_crypto->encrypt(ticket.dump());
+    session->send(response.dump());
+    
+    notifyChange();
+}
+
+void Server::dropActiveConnection() {
+    m_activeConnection = nullptr;
+    m_connected.store(false);
+    m_heartbeatGeneration++;
+    
+    if (m_jitterBuffer) {
+        m_jitterBuffer->flush();
     }
+    clearText();
+    m_gamepad->reset();
+    stopKeyRepeat();
+    
+    // Whatever the client held when it went would otherwise stay down here
+    m_replay->releaseHeld();
+    
+    m_ticketExpiry = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(SESSION_TICKET_TTL_MS);
+    notifyChange();
 }
 
-bool Server::validateConnection(const std::string& encryptedData, std::string& pcName) {
+void Server::sendHeartbeat(uint64_t generation) {
+    if (generation != m_heartbeatGeneration || !m_activeConnection) return;
+    
+    ClientSession* session = m_activeConnection;
+    auto silence = std::chrono::steady_clock::now() - session->lastReceived;
+    
+    // A silently dropped link only closes at the TCP timeout; don't wait for it
+    if (silence > std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS * HEARTBEAT_MISSES)) {
+        logWarn("Client stopped responding - disconnecting");
+        dropActiveConnection();
+        
+        // The relay socket and shared memory channel outlive any one client,
+        // so only a direct socket is closed; the others wait for a reattach
+        if (!session->direct) {
+            session->handshake = HandshakeState::AwaitingConnect;
+        } else if (session->transport) {
+            session->transport->close();
+        }
+        return;
+    }
+    
+    // Anything else we sent already told the client we are here
+    auto interval = std::chrono::milliseconds(HEARTBEAT_INTERVAL_MS);
+    auto idle = std::chrono::steady_clock::now() - session->lastSent;
+    if (idle >= interval) {
+        json heartbeat;
+        heartbeat["type"] = MsgType::HEARTBEAT;
+        session->send(heartbeat.dump());
+        idle = std::chrono::steady_clock::duration::zero();
+    }
+    
+    m_loop.runAfter(std::chrono::ceil<std::chrono::milliseconds>(interval - idle), [this, generation]() {
+        sendHeartbeat(generation);
+    });
+}
+
+void Server::rejectConnection(const std::shared_ptr<ClientSession>& session, const std::string& reason) {
+    session->handshake = HandshakeState::Rejected;
+    
+    json response;
+    response["type"] = MsgType::REJECT;
+    response["reason"] = reason;
+    session->send(response.dump());
+    session->transport->close();
+    releaseAdmission(session);
+}
+
+void Server::releaseAdmission(const std::shared_ptr<ClientSession>& session) {
+    if (!session->holdsAdmission) return;
+    
+    session->holdsAdmission = false;
+    m_admission.releaseConnection(session->remoteIp);
+}
+
+bool Server::validateTicket(const std::string& ticket) {
+    if (ticket.empty() || m_sessionTicket.empty()) return false;
+    if (std::chrono::steady_clock::now() > m_ticketExpiry) return false;
+    
+    return ticket == m_sessionTicket;
+}
+
+bool Server::validateConnection(const std::string& encryptedData, std::string& pcName,
+                                std::string& clientId, std::string& ticket, KeyRepeatTiming& keyRepeat) {
     std::string decrypted = m_crypto->decrypt(encryptedData);
     if (decrypted.empty()) return false;
     
     try {
         json j = json::parse(decrypted);
         pcName = j["pcName"].get<std::string>();
+        clientId = j.value("id", "");
+        ticket = j.value("ticket", "");
+        
+        // Older clients do not send theirs; use this machine's settings
+        keyRepeat = queryKeyRepeatTiming();
+        if (j.contains("kr")) {
+            keyRepeat.delayMs = j["kr"].at(0).get<int>();
+            keyRepeat.intervalMs = j["kr"].at(1).get<int>();
+        }
+        keyRepeat.delayMs = std::clamp(keyRepeat.delayMs, KEY_REPEAT_MIN_DELAY_MS, KEY_REPEAT_MAX_DELAY_MS);
+        keyRepeat.intervalMs = std::clamp(keyRepeat.intervalMs, KEY_REPEAT_MIN_INTERVAL_MS, KEY_REPEAT_MAX_INTERVAL_MS);
         return true;
     } catch (...) {
         return false;
     }
 }
 
-InputEvent Server::parseInputEvent(const std::string& jsonStr) {
+InputEvent Server::parseInputEvent(const std::string& jsonStr, uint64_t& seq) {
     InputEvent event{};
     
     try {
@@ -172,7 +1081,18 @@ InputEvent Server::parseInputEvent(const std::string& jsonStr) {
         event.y = j.value("y", 0);
         event.button = j.value("btn", 0);
         event.wheelDelta = j.value("wd", 0);
+        if (j.contains("gp")) {
+            const auto& gp = j["gp"];
+            event.gamepad.buttons = gp.at(0).get<uint16_t>();
+            event.gamepad.leftTrigger = gp.at(1).get<uint8_t>();
+            event.gamepad.rightTrigger = gp.at(2).get<uint8_t>();
+            event.gamepad.thumbLX = gp.at(3).get<int16_t>();
+            event.gamepad.thumbLY = gp.at(4).get<int16_t>();
+            event.gamepad.thumbRX = gp.at(5).get<int16_t>();
+            event.gamepad.thumbRY = gp.at(6).get<int16_t>();
+        }
         event.timestamp = j.value("ts", 0ULL);
+        seq = j.value("sq", 0ULL);
         
     } catch (...) {
         // Return empty event on parse error
@@ -181,4 +1101,21 @@ InputEvent Server::parseInputEvent(const std::string& jsonStr) {
     return event;
 }
 
+std::vector<MonitorRect> Server::parseLayout(const std::string& jsonStr) {
+    std::vector<MonitorRect> monitors;
+    
+    try {
+        json j = json::parse(jsonStr);
+        
+        for (const auto& m : j["m"]) {
+            monitors.push_back({m[0].get<int>(), m[1].get<int>(), m[2].get<int>(), m[3].get<int>()});
+        }
+    } catch (...) {
+        // Malformed layout: keep identity mapping
+        monitors.clear();
+    }
+    
+    return monitors;
+}
+    
 } // namespace GameAway
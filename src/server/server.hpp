@@ -1,15 +1,96 @@
 #pragma once
 
 #include "input_replay.hpp"
+#include "gamepad_replay.hpp"
+#include "jitter_buffer.hpp"
+#include "cursor_interpolator.hpp"
+#include "admission_control.hpp"
 #include "utils/crypto.hpp"
+#include "utils/input_filter.hpp"
+#include "utils/event_loop.hpp"
+#include "utils/discovery.hpp"
+#include "utils/transport.hpp"
+#include "utils/latency_histogram.hpp"
 #include <ixwebsocket/IXWebSocketServer.h>
 #include <functional>
 #include <atomic>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <set>
 
 namespace GameAway {
 
+// Per-connection handshake progress
+enum class HandshakeState {
+    AwaitingConnect,
+    AwaitingApproval,
+    Accepted,
+    Rejected
+};
+
+// Connection state attached to every socket by the WebSocket server. Once
+// the socket opens, only the server's network loop touches it.
+class ClientSession : public ix::ConnectionState {
+public:
+    ClientSession();
+    
+    HandshakeState handshake = HandshakeState::AwaitingConnect;
+    std::shared_ptr<Transport> transport;   // Keeps the link alive for queued work
+    
+    // Admission state of sockets from the listening server (relay and local
+    // links skip it). 'refused' is only touched by the connection thread;
+    // 'authenticated' tells that thread to stop rate limiting the socket.
+    bool direct = false;
+    bool refused = false;
+    bool holdsAdmission = false;
+    std::string remoteIp;
+    int remotePort = 0;
+    std::atomic<bool> authenticated{false};
+    
+    KeyRepeatTiming keyRepeat{};   // Client's autorepeat settings, from its handshake
+    std::chrono::steady_clock::time_point lastReceived;   // Any frame counts as a heartbeat
+    std::chrono::steady_clock::time_point lastSent;       // Heartbeats only fill the gaps
+    
+    bool send(const std::string& message);   // Through 'transport', noting lastSent (network loop only)
+    
+    // Receive buffers for input frames, reused once grown (network loop only)
+    std::vector<uint8_t> decoded;
+    std::string plaintext;
+    
+    // Frames handed from the connection thread to the loop. A fixed ring of
+    // strings that keep their capacity, so a steady stream of frames stops
+    // allocating after the first lap. 'open' holds frames back until the
+    // loop has seen the session's Open. A full ring blocks the pushing
+    // thread, which stops it reading the socket, so a client outrunning the
+    // loop is slowed by TCP rather than losing input; pushFrame only fails
+    // if 'running' clears while it waits.
+    bool pushFrame(const std::string& frame, const std::atomic<bool>& running);
+    bool popFrame(std::string& frame);          // Swaps the oldest frame into 'frame'
+    std::atomic<bool> inboxQueued{false};       // On the server's ready list
+    std::atomic<bool> open{false};
+
+private:
+    std::mutex m_inboxMutex;
+    std::condition_variable m_inboxSpace;
+    std::vector<std::string> m_inbox;
+    size_t m_inboxHead = 0;
+    size_t m_inboxCount = 0;
+};
+
+// A connection waiting for the user to accept or reject it
+struct ApprovalRequest {
+    uint64_t id;
+    std::string pcName;
+    std::string clientId;
+};
+
 class Server {
 public:
     Server(uint16_t port = 8765);
@@ -18,16 +99,53 @@ public:
     // Set the connection token
     void setToken(const std::string& token);
     
+    // Reach clients through a relay instead of listening for them directly.
+    // Call before start().
+    void setRelay(const std::string& host, uint16_t port);
+    
     // Start the server
     bool start();
     
     // Stop the server
     void stop();
     
-    // Set callback for connection approval
-    using ApprovalCallback = std::function<bool(const std::string& pcName)>;
+    // Set callback invoked when a connection is queued for approval.
+    // Runs on the network loop and must not block; answer the request
+    // later from the main loop with answerApproval().
+    using ApprovalCallback = std::function<void(const ApprovalRequest& request)>;
     void setApprovalCallback(ApprovalCallback callback);
     
+    // Take the oldest approval request not yet handed out, if any
+    bool nextApprovalRequest(ApprovalRequest& request);
+    
+    // Accept or reject a queued connection; 'remember' adds the client to the allowlist
+    void answerApproval(uint64_t id, bool approved, bool remember = false);
+    
+    // Load the allowlist of client IDs that are accepted without prompting.
+    // An ID is a copyable string from the client's client_id.txt, not a key
+    // fingerprint: anyone holding a copy of it, and the token, is trusted.
+    void loadTrustedClients(const std::string& path);
+    
+    // Allow/deny/remap rules applied again to received input before replay.
+    // Call before start().
+    bool loadInputRules(const std::string& path, std::string& error) { return m_filter.load(path, error); }
+    
+    // Set callback invoked whenever state shown to the user changes (events
+    // received, connection, pause). Runs on the network loop once per event,
+    // so it must be cheap.
+    using ChangeCallback = std::function<void()>;
+    void setChangeCallback(ChangeCallback callback);
+    
+    // Replay through a jitter buffer so motion keeps its original spacing;
+    // bypassDiscrete lets key/button events skip the delay. Call before start().
+    void setPlayoutSmoothing(bool enabled, bool bypassDiscrete = true);
+    int getPlayoutDelayMs() const { return m_jitterBuffer ? m_jitterBuffer->getTargetDelayMs() : 0; }
+    
+    // Interpolate the cursor between received move samples at outputHz,
+    // dead-reckoning up to extrapolateMs ahead (outputHz 0 disables).
+    // Call before start().
+    void setCursorInterpolation(int outputHz, int extrapolateMs);
+    
     // Pause/resume input replay
     void pause();
     void resume();
@@ -38,26 +156,172 @@ public:
     
     // Get statistics
     uint64_t getEventsReceived() const { return m_eventsReceived.load(); }
+    
+    // Heap allocations on the way from a received input frame to its
+    // InputEvent, summed over getInputFrames() frames; zero per frame once
+    // the session buffers have grown. Frames dropped on a full inbox at
+    // shutdown are counted separately.
+    uint64_t getReceiveAllocations() const { return m_receiveAllocations.load(); }
+    uint64_t getInputFrames() const { return m_inputFrames.load(); }
+    uint64_t getFramesDropped() const { return m_framesDropped.load(); }
+    
+    // Capture-to-replay latency of the current client: from the sender's hook
+    // to our SendInput (for moves, the interpolated cursor reaching them).
+    // Only absolute when both ends share a clock, e.g. a client on this PC
+    // connected as "local".
+    const LatencyHistogram& getLatency() const { return m_latency; }
 
 private:
     uint16_t m_port;
     std::string m_token;
+    std::string m_pairingId;    // Relay mode only
     std::unique_ptr<Crypto> m_crypto;
     std::unique_ptr<ix::WebSocketServer> m_server;
+    
+    // Single-peer links next to the listening server: the relay socket
+    // (pairs again and gets a fresh session on every reconnect) and the
+    // same-host shared memory channel. Sessions are network loop only.
+    std::string m_relayHost;
+    uint16_t m_relayPort = 0;
+    std::shared_ptr<ix::WebSocket> m_relaySocket;
+    std::shared_ptr<Transport> m_relayLink;
+    std::shared_ptr<ClientSession> m_relaySession;
+    std::shared_ptr<Transport> m_localLink;
+    std::shared_ptr<ClientSession> m_localSession;
+    
+    // The same sessions as seen by each link's own thread, which hands
+    // their frames to the loop. Guarded by m_incomingMutex: a link closed
+    // by the loop reports its Close on the loop thread.
+    std::mutex m_incomingMutex;
+    std::shared_ptr<ClientSession> m_relayIncoming;
+    std::shared_ptr<ClientSession> m_localIncoming;
+    
     std::unique_ptr<InputReplay> m_replay;
+    std::unique_ptr<GamepadReplay> m_gamepad;
+    InputFilter m_filter;   // Network loop only
+    std::unique_ptr<CursorInterpolator> m_cursor;      // Outlives m_jitterBuffer, which feeds it
+    std::unique_ptr<JitterBuffer> m_jitterBuffer;
+    DisplayWatcher m_displayWatcher;
+    DiscoveryBeacon m_beacon;
+    AdmissionControl m_admission;
+    
+    // Network runtime: connection threads only hand frames over, and this one
+    // loop owns every session, the handshake queue and replay ordering, so
+    // session state needs no locks however many sockets are open
+    EventLoop m_loop;
+    std::thread m_loopThread;
     ApprovalCallback m_approvalCallback;
+    ChangeCallback m_changeCallback;
+    
+    // Sessions with frames in their inbox. Connection threads add to
+    // m_ready and signal the loop, which swaps it with m_draining; both keep
+    // their capacity, as does m_frame, the frame being handled.
+    std::mutex m_readyMutex;
+    std::vector<std::shared_ptr<ClientSession>> m_ready;
+    std::vector<std::shared_ptr<ClientSession>> m_draining;
+    std::string m_frame;
     
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_paused{false};
     std::atomic<bool> m_connected{false};
     std::atomic<uint64_t> m_eventsReceived{0};
+    std::atomic<uint64_t> m_receiveAllocations{0};
+    std::atomic<uint64_t> m_inputFrames{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+    LatencyHistogram m_latency;
+    
+    // Session resumption (network loop only): the ticket lets a dropped client
+    // reattach without re-approval, and m_lastSeq tells it which buffered
+    // events we already have. Moves and stick positions are never buffered
+    // and keep their own last seq.
+    std::string m_sessionTicket;
+    std::chrono::steady_clock::time_point m_ticketExpiry;
+    uint64_t m_lastSeq = 0;
+    uint64_t m_lastMoveSeq = 0;
+    uint64_t m_lastAxesSeq = 0;
+    ClientSession* m_activeConnection = nullptr;
+    
+    // Pasted text still to be typed (network loop only). It goes out in
+    // paced batches from loop timers, so the loop never blocks on it.
+    std::wstring m_text;
+    size_t m_textOffset = 0;
+    bool m_textScheduled = false;
+    std::chrono::steady_clock::time_point m_textModifierDeadline;
     
-    void handleMessage(std::shared_ptr<ix::ConnectionState> connectionState,
-                       ix::WebSocket& webSocket,
-                       const ix::WebSocketMessagePtr& msg);
+    // Autorepeat of the most recently pressed key (network loop only). The
+    // client forwards only edges; a held key repeats from loop timers.
+    KeyRepeatTiming m_keyRepeat{};
+    InputEvent m_repeatKey{};
+    uint64_t m_repeatGeneration = 0;   // Bumped to cancel the scheduled repeat
     
-    InputEvent parseInputEvent(const std::string& json);
-    bool validateConnection(const std::string& encryptedData, std::string& pcName);
+    // Heartbeat of the active connection (network loop only): sent every
+    // HEARTBEAT_INTERVAL_MS when nothing else went out, and a client silent
+    // for HEARTBEAT_MISSES intervals is dropped without waiting for its
+    // socket to close
+    uint64_t m_heartbeatGeneration = 0;
+    
+    // Connections queued for approval; the main loop reads the queue, so it
+    // stays under m_approvalMutex even though only the network loop edits it
+    struct PendingApproval {
+        ApprovalRequest request;
+        std::shared_ptr<ClientSession> session;
+        bool handedOut;
+    };
+    std::mutex m_approvalMutex;
+    std::deque<PendingApproval> m_pendingApprovals;
+    uint64_t m_nextApprovalId = 1;
+    std::set<std::string> m_trustedClients;
+    std::string m_trustedClientsPath;
+    
+    // Runs on a connection thread: pins the socket and queues the frame
+    void dispatchMessage(std::shared_ptr<ix::ConnectionState> connectionState,
+                         ix::WebSocket& webSocket,
+                         const ix::WebSocketMessagePtr& msg);
+    
+    // Runs on a single-peer link's thread, queueing like dispatchMessage;
+    // each Open starts a new session in 'incoming' (link thread) and
+    // 'current' (network loop)
+    void dispatchLinkEvent(const std::shared_ptr<Transport>& link,
+                           std::shared_ptr<ClientSession>& current,
+                           std::shared_ptr<ClientSession>& incoming,
+                           TransportEvent event,
+                           const std::string& data);
+    
+    // Runs on a connection or link thread: hands a frame to the loop
+    void enqueueFrame(const std::shared_ptr<ClientSession>& session, const std::string& frame);
+    
+    // Network loop only
+    void drainInboxes();
+    void drainSession(const std::shared_ptr<ClientSession>& session);
+    void handleInput(const std::shared_ptr<ClientSession>& session, std::string_view data);
+    void handleMessage(const std::shared_ptr<ClientSession>& session,
+                       TransportEvent event,
+                       const std::string& payload);
+    void handleApproval(uint64_t id, bool approved, bool remember);
+    void acceptConnection(const std::shared_ptr<ClientSession>& session, bool resumed);
+    void dropActiveConnection();
+    void sendHeartbeat(uint64_t generation);
+    void rejectConnection(const std::shared_ptr<ClientSession>& session, const std::string& reason);
+    void releaseAdmission(const std::shared_ptr<ClientSession>& session);
+    bool validateTicket(const std::string& ticket);
+    void saveTrustedClients();
+    void notifyChange();
+    
+    void queueText(const std::string& utf8);
+    void typeTextBatch();
+    void clearText();
+    void trackKeyRepeat(const InputEvent& event);
+    void repeatKey(uint64_t generation);
+    void stopKeyRepeat();
+    
+    void deliverEvent(const InputEvent& event);
+    void replayEvent(const InputEvent& event);
+    void recordLatency(uint64_t timestamp);   // Capture timestamp of an event just injected
+    
+    InputEvent parseInputEvent(const std::string& json, uint64_t& seq);
+    std::vector<MonitorRect> parseLayout(const std::string& json);
+    bool validateConnection(const std::string& encryptedData, std::string& pcName,
+                            std::string& clientId, std::string& ticket, KeyRepeatTiming& keyRepeat);
 };
-
+    
 } // namespace GameAway
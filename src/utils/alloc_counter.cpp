@@ -0,0 +1,42 @@
+#include "alloc_counter.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local uint64_t t_allocations = 0;
+
+} // namespace
+
+namespace GameAway {
+
+uint64_t threadAllocationCount() {
+    return t_allocations;
+}
+
+} // namespace GameAway
+
+// The array and nothrow forms of the standard library call these, so they
+// are counted too. Over-aligned allocations keep the default implementation.
+void* operator new(std::size_t size) {
+    ++t_allocations;
+    
+    if (size == 0) size = 1;
+    
+    while (true) {
+        void* p = std::malloc(size);
+        if (p) return p;
+        
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
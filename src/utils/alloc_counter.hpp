@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+namespace GameAway {
+
+// Heap allocations made so far by the calling thread. alloc_counter.cpp
+// replaces the global operator new to keep this count, so the difference
+// across a piece of code tells whether it touched the heap. Allocations
+// inside the OS (e.g. BCrypt, Winsock) do not go through operator new and
+// are not counted.
+uint64_t threadAllocationCount();
+
+} // namespace GameAway
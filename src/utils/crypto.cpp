@@ -13,6 +13,7 @@ namespace GameAway {
 constexpr ULONG KEY_SIZE = 32;  // 256 bits
 constexpr ULONG NONCE_SIZE = 12; // 96 bits for GCM
 constexpr ULONG TAG_SIZE = 16;   // 128 bits auth tag
+constexpr ULONG MAC_SIZE = 32;   // HMAC-SHA256 output
 
 // Base64 character set
 static const char base64Chars[] = 
@@ -48,7 +49,7 @@ std::string base64Encode(const std::vector<uint8_t>& data) {
     return result;
 }
 
-std::vector<uint8_t> base64Decode(const std::string& encoded) {
+void base64DecodeInto(std::string_view encoded, std::vector<uint8_t>& result) {
     static const int decodeTable[256] = {
         -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
         -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
@@ -68,7 +69,8 @@ std::vector<uint8_t> base64Decode(const std::string& encoded) {
         -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
     };
     
-    std::vector<uint8_t> result;
+    // clear() keeps the capacity, so a reused buffer is not reallocated
+    result.clear();
     result.reserve((encoded.size() / 4) * 3);
     
     int val = 0, valb = -8;
@@ -83,12 +85,16 @@ std::vector<uint8_t> base64Decode(const std::string& encoded) {
             valb -= 8;
         }
     }
-    
+}
+
+std::vector<uint8_t> base64Decode(const std::string& encoded) {
+    std::vector<uint8_t> result;
+    base64DecodeInto(encoded, result);
     return result;
 }
 
-Crypto::Crypto(const std::string& token) {
-    m_valid = deriveKey(token);
+Crypto::Crypto(const std::string& token, KeyPurpose purpose) {
+    m_valid = deriveKey(token, purpose);
     
     if (m_valid) {
         NTSTATUS status = BCryptOpenAlgorithmProvider(
@@ -120,6 +126,9 @@ Crypto::Crypto(const std::string& token) {
 }
 
 Crypto::~Crypto() {
+    if (m_hDecryptKey) {
+        BCryptDestroyKey(reinterpret_cast<BCRYPT_KEY_HANDLE>(m_hDecryptKey));
+    }
     if (m_hAlg) {
         BCryptCloseAlgorithmProvider(reinterpret_cast<BCRYPT_ALG_HANDLE>(m_hAlg), 0);
     }
@@ -127,7 +136,7 @@ Crypto::~Crypto() {
     SecureZeroMemory(m_key.data(), m_key.size());
 }
 
-bool Crypto::deriveKey(const std::string& token) {
+bool Crypto::deriveKey(const std::string& token, KeyPurpose purpose) {
     // Use PBKDF2 to derive a 256-bit key from the token
     BCRYPT_ALG_HANDLE hPrf = nullptr;
     NTSTATUS status = BCryptOpenAlgorithmProvider(
@@ -139,8 +148,13 @@ bool Crypto::deriveKey(const std::string& token) {
     
     if (status != 0) return false;
     
-    // Salt derived from application name
+    // Salt derived from application name, one per purpose
     const char* salt = "GameAway_v1.0_Salt";
+    switch (purpose) {
+        case KeyPurpose::Session: break;
+        case KeyPurpose::Pairing: salt = "GameAway_v1.0_Salt:pair"; break;
+        case KeyPurpose::Discovery: salt = "GameAway_v1.0_Salt:beacon"; break;
+    }
     
     m_key.resize(KEY_SIZE);
     
@@ -314,4 +328,95 @@ std::string Crypto::decrypt(const std::string& ciphertextB64) {
     return std::string(plaintext.begin(), plaintext.end());
 }
 
+bool Crypto::decryptInto(std::string_view ciphertextB64, std::vector<uint8_t>& scratch,
+                         std::string& plaintext) {
+    if (!m_valid) return false;
+    
+    base64DecodeInto(ciphertextB64, scratch);
+    if (scratch.size() < NONCE_SIZE + TAG_SIZE) return false;
+    
+    // Unlike decrypt(), keep one key object for all calls
+    if (!m_hDecryptKey) {
+        NTSTATUS status = BCryptGenerateSymmetricKey(
+            reinterpret_cast<BCRYPT_ALG_HANDLE>(m_hAlg),
+            reinterpret_cast<BCRYPT_KEY_HANDLE*>(&m_hDecryptKey),
+            nullptr,
+            0,
+            m_key.data(),
+            KEY_SIZE,
+            0
+        );
+        
+        if (status != 0) {
+            m_hDecryptKey = nullptr;
+            return false;
+        }
+    }
+    
+    // Nonce, tag and ciphertext are used in place in the decoded buffer
+    BCRYPT_AUTHENTICATED_CIPHER_MODE_INFO authInfo;
+    BCRYPT_INIT_AUTH_MODE_INFO(authInfo);
+    authInfo.pbNonce = scratch.data();
+    authInfo.cbNonce = NONCE_SIZE;
+    authInfo.pbTag = scratch.data() + NONCE_SIZE;
+    authInfo.cbTag = TAG_SIZE;
+    
+    // GCM plaintext is exactly as long as the ciphertext
+    ULONG ciphertextSize = static_cast<ULONG>(scratch.size() - NONCE_SIZE - TAG_SIZE);
+    plaintext.resize(ciphertextSize);
+    
+    ULONG plaintextSize = 0;
+    NTSTATUS status = BCryptDecrypt(
+        reinterpret_cast<BCRYPT_KEY_HANDLE>(m_hDecryptKey),
+        scratch.data() + NONCE_SIZE + TAG_SIZE,
+        ciphertextSize,
+        &authInfo,
+        nullptr,
+        0,
+        reinterpret_cast<PUCHAR>(plaintext.data()),
+        ciphertextSize,
+        &plaintextSize,
+        0
+    );
+    
+    if (status != 0) {
+        plaintext.clear();
+        return false;
+    }
+    
+    plaintext.resize(plaintextSize);
+    return true;
+}
+
+std::string Crypto::sign(const std::string& message) {
+    if (!m_valid) return "";
+    
+    std::vector<uint8_t> mac(MAC_SIZE);
+    NTSTATUS status = BCryptHash(
+        BCRYPT_HMAC_SHA256_ALG_HANDLE,
+        m_key.data(),
+        KEY_SIZE,
+        reinterpret_cast<PUCHAR>(const_cast<char*>(message.data())),
+        static_cast<ULONG>(message.size()),
+        mac.data(),
+        MAC_SIZE
+    );
+    
+    if (status != 0) return "";
+    
+    return base64Encode(mac);
+}
+
+bool Crypto::verify(const std::string& message, const std::string& signature) {
+    std::string expected = sign(message);
+    if (expected.empty() || expected.size() != signature.size()) return false;
+    
+    // Accumulate differences so timing does not reveal the first mismatch
+    uint8_t diff = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        diff |= static_cast<uint8_t>(expected[i] ^ signature[i]);
+    }
+    return diff == 0;
+}
+
 } // namespace GameAway
@@ -1,15 +1,24 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 
 namespace GameAway {
 
+// What a key derived from the token is for. Each purpose is its own PBKDF2
+// output, so a value computed under one key says nothing about the others.
+enum class KeyPurpose {
+    Session,    // Encrypts the session between the peers
+    Pairing,    // Relay pairing ID, sent in the clear
+    Discovery   // Signs LAN beacons, which anyone on the network can read
+};
+
 class Crypto {
 public:
     // Initialize crypto with a token (derives encryption key)
-    explicit Crypto(const std::string& token);
+    explicit Crypto(const std::string& token, KeyPurpose purpose = KeyPurpose::Session);
     ~Crypto();
     
     // Encrypt plaintext, returns base64-encoded ciphertext with nonce
@@ -18,6 +27,17 @@ public:
     // Decrypt base64-encoded ciphertext, returns plaintext
     std::string decrypt(const std::string& ciphertext);
     
+    // Decrypt without allocating once the buffers have grown: 'scratch' holds
+    // the decoded bytes, 'plaintext' receives the result. Reuses one key
+    // object across calls, so calls must not overlap; decrypt() has no such limit.
+    bool decryptInto(std::string_view ciphertext, std::vector<uint8_t>& scratch, std::string& plaintext);
+    
+    // HMAC-SHA256 of a message under the derived key, base64-encoded
+    std::string sign(const std::string& message);
+    
+    // Check a signature from sign() in constant time
+    bool verify(const std::string& message, const std::string& signature);
+    
     // Check if crypto is properly initialized
     bool isValid() const { return m_valid; }
 
@@ -25,13 +45,17 @@ private:
     std::vector<uint8_t> m_key;
     bool m_valid = false;
     void* m_hAlg = nullptr;
+    void* m_hDecryptKey = nullptr;   // decryptInto() only
     
     // Derive key from token using PBKDF2
-    bool deriveKey(const std::string& token);
+    bool deriveKey(const std::string& token, KeyPurpose purpose);
 };
 
 // Base64 encoding/decoding utilities
 std::string base64Encode(const std::vector<uint8_t>& data);
 std::vector<uint8_t> base64Decode(const std::string& encoded);
 
+// Decode into an existing buffer, reusing its capacity
+void base64DecodeInto(std::string_view encoded, std::vector<uint8_t>& result);
+
 } // namespace GameAway
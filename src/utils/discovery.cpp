@@ -0,0 +1,336 @@
+#include "discovery.hpp"
+#include "config.hpp"
+#include "token.hpp"
+#include <ws2tcpip.h>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+namespace GameAway {
+
+// Beacon: "GA|<version>|<port>|<hostname>|<addresses>|<unix time>|<nonce>|<signature>",
+// where the signature covers everything before the last separator. The
+// addresses bind it to the machine that sent it, and the time and nonce
+// let a repeat be told from a fresh beacon.
+static constexpr const char* BEACON_MAGIC = "GA";
+static constexpr size_t BEACON_MAX_SIZE = 512;
+static constexpr size_t BEACON_MAX_ADDRESSES = 8;
+static constexpr size_t BEACON_NONCE_LENGTH = 8;
+
+static std::vector<std::string> splitBeacon(const std::string& beacon) {
+    std::vector<std::string> fields;
+    std::stringstream stream(beacon);
+    std::string field;
+    while (std::getline(stream, field, '|')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+static int64_t unixTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+DiscoveryBeacon::~DiscoveryBeacon() {
+    stop();
+}
+
+bool DiscoveryBeacon::start(const std::string& token, uint16_t port) {
+    if (m_thread.joinable()) return false;
+    
+    // Not the session key: anyone on the LAN can collect beacons and test
+    // guesses at the token against them
+    m_crypto = std::make_unique<Crypto>(token, KeyPurpose::Discovery);
+    if (!m_crypto->isValid()) return false;
+    
+    m_port = port;
+    m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket == INVALID_SOCKET) return false;
+    
+    BOOL enable = TRUE;
+    setsockopt(m_socket, SOL_SOCKET, SO_BROADCAST, reinterpret_cast<const char*>(&enable), sizeof(enable));
+    
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    m_thread = std::thread(&DiscoveryBeacon::broadcastLoop, this);
+    return true;
+}
+
+void DiscoveryBeacon::stop() {
+    if (m_thread.joinable()) {
+        SetEvent(m_stopEvent);
+        m_thread.join();
+    }
+    
+    if (m_stopEvent) {
+        CloseHandle(m_stopEvent);
+        m_stopEvent = nullptr;
+    }
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
+std::string DiscoveryBeacon::buildBeacon() {
+    std::string signedPart = std::string(BEACON_MAGIC) + "|" +
+        std::to_string(DISCOVERY_VERSION) + "|" +
+        std::to_string(m_port) + "|" +
+        getPcName() + "|" +
+        localAddresses() + "|" +
+        std::to_string(unixTime()) + "|" +
+        generateToken(BEACON_NONCE_LENGTH);
+    
+    return signedPart + "|" + m_crypto->sign(signedPart);
+}
+
+std::string DiscoveryBeacon::localAddresses() {
+    char hostName[256] = {};
+    if (gethostname(hostName, sizeof(hostName)) != 0) return "";
+    
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    addrinfo* results = nullptr;
+    if (getaddrinfo(hostName, nullptr, &hints, &results) != 0) return "";
+    
+    std::string addresses;
+    size_t count = 0;
+    for (addrinfo* entry = results; entry && count < BEACON_MAX_ADDRESSES; entry = entry->ai_next) {
+        char address[INET_ADDRSTRLEN] = {};
+        auto* ipv4 = reinterpret_cast<const sockaddr_in*>(entry->ai_addr);
+        if (!inet_ntop(AF_INET, &ipv4->sin_addr, address, sizeof(address))) continue;
+        
+        if (count++ > 0) addresses += ",";
+        addresses += address;
+    }
+    
+    freeaddrinfo(results);
+    return addresses;
+}
+
+void DiscoveryBeacon::broadcastLoop() {
+    sockaddr_in target{};
+    target.sin_family = AF_INET;
+    target.sin_port = htons(DISCOVERY_PORT);
+    target.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    
+    // Announce immediately, then once per interval until stopped
+    do {
+        std::string beacon = buildBeacon();
+        sendto(m_socket, beacon.data(), static_cast<int>(beacon.size()), 0,
+               reinterpret_cast<const sockaddr*>(&target), sizeof(target));
+    } while (WaitForSingleObject(m_stopEvent, DISCOVERY_INTERVAL_MS) == WAIT_TIMEOUT);
+}
+
+DiscoveryListener::~DiscoveryListener() {
+    stop();
+}
+
+bool DiscoveryListener::start() {
+    if (m_thread.joinable()) return false;
+    
+    m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (m_socket == INVALID_SOCKET) return false;
+    
+    // Several clients on one machine may all listen
+    BOOL enable = TRUE;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&enable), sizeof(enable));
+    
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(DISCOVERY_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    
+    if (bind(m_socket, reinterpret_cast<const sockaddr*>(&local), sizeof(local)) == SOCKET_ERROR) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+        return false;
+    }
+    
+    // Event-driven receive: the thread sleeps until a datagram or stop()
+    m_readEvent = WSACreateEvent();
+    WSAEventSelect(m_socket, m_readEvent, FD_READ);
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    
+    m_thread = std::thread(&DiscoveryListener::receiveLoop, this);
+    return true;
+}
+
+void DiscoveryListener::stop() {
+    if (m_thread.joinable()) {
+        SetEvent(m_stopEvent);
+        m_thread.join();
+    }
+    
+    if (m_stopEvent) {
+        CloseHandle(m_stopEvent);
+        m_stopEvent = nullptr;
+    }
+    if (m_readEvent) {
+        WSACloseEvent(m_readEvent);
+        m_readEvent = nullptr;
+    }
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
+void DiscoveryListener::receiveLoop() {
+    HANDLE handles[2] = {m_stopEvent, m_readEvent};
+    char buffer[BEACON_MAX_SIZE];
+    
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        WSAResetEvent(m_readEvent);
+        
+        // Drain everything queued; the socket is non-blocking after WSAEventSelect
+        for (;;) {
+            sockaddr_in from{};
+            int fromLength = sizeof(from);
+            int received = recvfrom(m_socket, buffer, sizeof(buffer), 0,
+                                    reinterpret_cast<sockaddr*>(&from), &fromLength);
+            if (received == SOCKET_ERROR) break;
+            
+            char address[INET_ADDRSTRLEN] = {};
+            inet_ntop(AF_INET, &from.sin_addr, address, sizeof(address));
+            handleBeacon(std::string(buffer, received), address);
+        }
+    }
+}
+
+void DiscoveryListener::handleBeacon(const std::string& beacon, const std::string& address) {
+    std::vector<std::string> fields = splitBeacon(beacon);
+    if (fields.size() != 8 || fields[0] != BEACON_MAGIC) return;
+    
+    DiscoveredServer server;
+    try {
+        server.version = std::stoi(fields[1]);
+        int port = std::stoi(fields[2]);
+        server.sentAt = std::stoll(fields[5]);
+        
+        if (port <= 0 || port > 65535) return;
+        
+        // The timestamp is signed, so a stale replayed beacon cannot pass
+        if (std::llabs(unixTime() - server.sentAt) > DISCOVERY_MAX_SKEW_S) return;
+        
+        server.port = static_cast<uint16_t>(port);
+    } catch (...) {
+        return;
+    }
+    
+    // The signed address list must name the sender, so a fresh beacon
+    // replayed from another machine points nowhere
+    bool fromSigner = false;
+    std::stringstream addresses(fields[4]);
+    std::string signer;
+    while (std::getline(addresses, signer, ',')) {
+        fromSigner = fromSigner || signer == address;
+    }
+    if (!fromSigner) return;
+    
+    server.address = address;
+    server.hostName = fields[3];
+    server.nonce = fields[6];
+    server.signedPart = beacon.substr(0, beacon.rfind('|'));
+    server.signature = fields[7];
+    server.lastSeen = std::chrono::steady_clock::now();
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        
+        std::string key = address + ":" + fields[2];
+        if (m_verifier) {
+            verify(key, server);
+        }
+        m_servers[key] = std::move(server);
+    }
+    m_cv.notify_all();
+}
+
+void DiscoveryListener::verify(const std::string& key, const DiscoveredServer& server) {
+    if (server.version != DISCOVERY_VERSION || !m_verifier->verify(server.signedPart, server.signature)) return;
+    
+    // A repeat of a beacon already verified is a replay, not a sign of life
+    auto existing = m_verified.find(key);
+    if (existing != m_verified.end() &&
+        (server.sentAt < existing->second.sentAt ||
+         (server.sentAt == existing->second.sentAt && server.nonce == existing->second.nonce))) {
+        return;
+    }
+    
+    m_verified[key] = server;
+}
+
+void DiscoveryListener::pruneExpired() {
+    auto cutoff = std::chrono::steady_clock::now() - std::chrono::milliseconds(DISCOVERY_TTL_MS);
+    
+    for (auto* cache : {&m_servers, &m_verified}) {
+        for (auto it = cache->begin(); it != cache->end();) {
+            if (it->second.lastSeen < cutoff) {
+                it = cache->erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+std::vector<DiscoveredServer> DiscoveryListener::getServers() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    pruneExpired();
+    
+    std::vector<DiscoveredServer> servers;
+    for (const auto& entry : m_servers) {
+        servers.push_back(entry.second);
+    }
+    return servers;
+}
+
+bool DiscoveryListener::findServer(const std::string& token, std::chrono::milliseconds timeout,
+                                   DiscoveredServer& server) {
+    // Key derivation is slow; do it once, outside the lock
+    Crypto crypto(token, KeyPurpose::Discovery);
+    if (!crypto.isValid()) return false;
+    
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    // What verified under another token says nothing about this one
+    if (token != m_verifiedToken) {
+        m_verified.clear();
+        m_verifiedToken = token;
+    }
+    
+    // Beacons heard before we knew the token; from here on they are
+    // verified on arrival
+    m_verifier = &crypto;
+    for (const auto& entry : m_servers) {
+        verify(entry.first, entry.second);
+    }
+    
+    bool found = false;
+    for (;;) {
+        pruneExpired();
+        
+        const DiscoveredServer* newest = nullptr;
+        for (const auto& entry : m_verified) {
+            if (!newest || entry.second.lastSeen > newest->lastSeen) {
+                newest = &entry.second;
+            }
+        }
+        if (newest) {
+            server = *newest;
+            found = true;
+            break;
+        }
+        
+        if (std::chrono::steady_clock::now() >= deadline) break;
+        m_cv.wait_until(lock, deadline);
+    }
+    
+    m_verifier = nullptr;
+    return found;
+}
+    
+} // namespace GameAway
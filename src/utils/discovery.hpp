@@ -0,0 +1,110 @@
+#pragma once
+
+#include "crypto.hpp"
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GameAway {
+
+// A server seen on the local network. The beacon is signed with a key
+// derived from the server's token for this purpose alone, so it only
+// verifies for clients that were given that token.
+struct DiscoveredServer {
+    std::string address;    // Source address of the beacon, one of those it signed
+    uint16_t port;
+    std::string hostName;
+    int version;
+    int64_t sentAt;         // Server's clock, unix seconds
+    std::string nonce;
+    std::string signedPart; // Beacon text covered by the signature
+    std::string signature;
+    std::chrono::steady_clock::time_point lastSeen;
+};
+
+// Broadcasts a signed beacon for a listening server every DISCOVERY_INTERVAL_MS
+class DiscoveryBeacon {
+public:
+    DiscoveryBeacon() = default;
+    ~DiscoveryBeacon();
+    
+    // Start announcing the server on this port
+    bool start(const std::string& token, uint16_t port);
+    
+    // Stop announcing
+    void stop();
+
+private:
+    std::unique_ptr<Crypto> m_crypto;
+    uint16_t m_port = 0;
+    SOCKET m_socket = INVALID_SOCKET;
+    HANDLE m_stopEvent = nullptr;
+    std::thread m_thread;
+    
+    void broadcastLoop();
+    std::string buildBeacon();
+    
+    // This machine's IPv4 addresses, comma-separated; looked up per beacon
+    // so a new DHCP lease shows up
+    static std::string localAddresses();
+};
+
+// Collects beacons into a cache whose entries expire after DISCOVERY_TTL_MS.
+// Anyone on the LAN can send a beacon, so the cache only records what was
+// heard; ordering and replay checks apply to beacons that verified under
+// the token given to findServer(), and an unverified one can never hide them.
+class DiscoveryListener {
+public:
+    DiscoveryListener() = default;
+    ~DiscoveryListener();
+    
+    // Start listening in the background
+    bool start();
+    
+    // Stop listening (the cache is kept)
+    void stop();
+    
+    // Servers seen within the TTL
+    std::vector<DiscoveredServer> getServers();
+    
+    // Wait up to 'timeout' for a server whose beacon verifies under this
+    // token; the most recently heard one if several do
+    bool findServer(const std::string& token, std::chrono::milliseconds timeout, DiscoveredServer& server);
+
+private:
+    SOCKET m_socket = INVALID_SOCKET;
+    HANDLE m_readEvent = nullptr;
+    HANDLE m_stopEvent = nullptr;
+    std::thread m_thread;
+    
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::map<std::string, DiscoveredServer> m_servers;   // Latest heard, keyed by address:port
+    
+    // Beacons that verified under m_verifiedToken, by the same key. Only
+    // these are checked for replays. m_verifier is set while findServer()
+    // waits, so beacons are verified as they arrive.
+    std::map<std::string, DiscoveredServer> m_verified;
+    std::string m_verifiedToken;
+    Crypto* m_verifier = nullptr;
+    
+    void receiveLoop();
+    void handleBeacon(const std::string& beacon, const std::string& address);
+    void pruneExpired();
+    
+    // m_mutex held
+    void verify(const std::string& key, const DiscoveredServer& server);
+};
+    
+} // namespace GameAway
@@ -0,0 +1,145 @@
+#include "event_loop.hpp"
+#include <algorithm>
+
+namespace GameAway {
+
+EventLoop::EventLoop() {
+    // Auto-reset: one wake per SetEvent, no manual bookkeeping
+    m_wakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+}
+
+EventLoop::~EventLoop() {
+    if (m_wakeEvent) {
+        CloseHandle(m_wakeEvent);
+    }
+}
+
+void EventLoop::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_posted.push_back(std::move(task));
+    }
+    SetEvent(m_wakeEvent);
+}
+
+void EventLoop::signal() {
+    if (!m_signalled.exchange(true)) {
+        SetEvent(m_wakeEvent);
+    }
+}
+
+void EventLoop::setSignalHandler(Task handler) {
+    m_signalHandler = std::move(handler);
+}
+
+void EventLoop::setMessageHandler(MessageHandler handler) {
+    m_messageHandler = std::move(handler);
+}
+
+void EventLoop::runAfter(std::chrono::milliseconds delay, Task task) {
+    m_timers.push_back({std::chrono::steady_clock::now() + delay, std::move(task)});
+}
+
+void EventLoop::watchHandle(HANDLE handle, Task handler) {
+    unwatchHandle(handle);
+    m_watches.push_back({handle, std::move(handler)});
+}
+
+void EventLoop::unwatchHandle(HANDLE handle) {
+    m_watches.erase(std::remove_if(m_watches.begin(), m_watches.end(),
+        [handle](const Watch& watch) { return watch.handle == handle; }), m_watches.end());
+}
+
+void EventLoop::stop() {
+    m_stopped.store(true);
+    SetEvent(m_wakeEvent);
+}
+
+void EventLoop::run() {
+    std::vector<HANDLE> handles;
+    
+    while (!m_stopped.load()) {
+        handles.assign(1, m_wakeEvent);
+        for (const auto& watch : m_watches) {
+            handles.push_back(watch.handle);
+        }
+        DWORD count = static_cast<DWORD>(handles.size());
+        
+        DWORD result = MsgWaitForMultipleObjects(count, handles.data(), FALSE, nextTimeout(), QS_ALLINPUT);
+        
+        if (result == WAIT_FAILED) break;
+        
+        // Copied first: the handler may unwatch itself
+        if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count) {
+            Task handler = m_watches[result - WAIT_OBJECT_0 - 1].handler;
+            handler();
+        }
+        
+        if (result == WAIT_OBJECT_0 + count) {
+            MSG msg;
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                if (m_messageHandler) {
+                    m_messageHandler(msg);
+                }
+            }
+        }
+        
+        runPosted();
+        
+        if (m_signalled.exchange(false) && m_signalHandler) {
+            m_signalHandler();
+        }
+        
+        runDueTimers();
+    }
+    
+    // Consumed, so the loop can be run again
+    m_stopped.store(false);
+}
+
+DWORD EventLoop::nextTimeout() const {
+    if (m_timers.empty()) return INFINITE;
+    
+    auto now = std::chrono::steady_clock::now();
+    auto next = std::min_element(m_timers.begin(), m_timers.end(),
+        [](const Timer& a, const Timer& b) { return a.due < b.due; })->due;
+    
+    if (next <= now) return 0;
+    
+    // Round up so we never wake just before the deadline and spin
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count() + 1;
+    return static_cast<DWORD>(remaining);
+}
+
+void EventLoop::runPosted() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tasks.swap(m_posted);
+    }
+    
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void EventLoop::runDueTimers() {
+    auto now = std::chrono::steady_clock::now();
+    
+    // Split out due timers first; tasks may schedule new ones
+    std::vector<Task> due;
+    for (auto it = m_timers.begin(); it != m_timers.end();) {
+        if (it->due <= now) {
+            due.push_back(std::move(it->task));
+            it = m_timers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    for (auto& task : due) {
+        task();
+    }
+}
+
+} // namespace GameAway
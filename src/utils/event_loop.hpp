@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <chrono>
+
+namespace GameAway {
+
+// Single-threaded event loop, used by the main thread and as the server's
+// network runtime. Blocks until a thread message (hotkeys), posted work, a
+// signal, a watched handle or a due timer needs handling, so an idle
+// process never wakes up.
+class EventLoop {
+public:
+    using Task = std::function<void()>;
+    using MessageHandler = std::function<void(const MSG& msg)>;
+    
+    EventLoop();
+    ~EventLoop();
+    
+    // Run a task on the loop thread (thread-safe)
+    void post(Task task);
+    
+    // Request a run of the signal handler; repeated signals collapse into
+    // one until it runs, so this is cheap enough to call per input event
+    void signal();
+    void setSignalHandler(Task handler);
+    
+    // Handle thread messages such as WM_HOTKEY
+    void setMessageHandler(MessageHandler handler);
+    
+    // Run a task once after a delay (loop thread only)
+    void runAfter(std::chrono::milliseconds delay, Task task);
+    
+    // Run 'handler' whenever 'handle' is signalled, e.g. console input,
+    // until unwatched (loop thread only). A handle that stays signalled,
+    // like console input, must be consumed by the handler.
+    void watchHandle(HANDLE handle, Task handler);
+    void unwatchHandle(HANDLE handle);
+    
+    // Run until stop() is called; a stop() before run() ends the next run
+    // at once. Can be run again afterwards.
+    void run();
+    
+    // Stop the loop (thread-safe, e.g. from a console control handler)
+    void stop();
+
+private:
+    struct Timer {
+        std::chrono::steady_clock::time_point due;
+        Task task;
+    };
+    
+    struct Watch {
+        HANDLE handle;
+        Task handler;
+    };
+    
+    HANDLE m_wakeEvent = nullptr;
+    std::mutex m_mutex;
+    std::vector<Task> m_posted;
+    std::vector<Timer> m_timers;
+    std::vector<Watch> m_watches;   // At most MAXIMUM_WAIT_OBJECTS - 1
+    std::atomic<bool> m_signalled{false};
+    std::atomic<bool> m_stopped{false};
+    Task m_signalHandler;
+    MessageHandler m_messageHandler;
+    
+    DWORD nextTimeout() const;
+    void runPosted();
+    void runDueTimers();
+};
+
+} // namespace GameAway
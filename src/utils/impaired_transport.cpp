@@ -0,0 +1,451 @@
+#include "impaired_transport.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace GameAway {
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr int MAX_RETRANSMITS = 6;   // A real sender gives up about here; the stall stops growing instead
+
+bool parseNumber(const std::string& value, double low, double high, double& result) {
+    try {
+        size_t used = 0;
+        result = std::stod(value, &used);
+        return used == value.size() && result >= low && result <= high;
+    } catch (...) {
+        return false;
+    }
+}
+
+std::string percent(double fraction) {
+    std::ostringstream out;
+    out << fraction * 100 << "%";
+    return out.str();
+}
+
+} // namespace
+
+bool ImpairmentProfile::parse(const std::string& text, ImpairmentProfile& profile, std::string& error) {
+    ImpairmentProfile parsed;
+    std::istringstream lines(text);
+    std::string line;
+    
+    while (std::getline(lines, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string token;
+        
+        while (tokens >> token) {
+            size_t eq = token.find('=');
+            if (eq == std::string::npos) {
+                error = "expected key=value: " + token;
+                return false;
+            }
+            std::string key = token.substr(0, eq);
+            std::string value = token.substr(eq + 1);
+            double number = 0;
+            bool ok = true;
+            
+            if (key == "distribution") {
+                if (value == "uniform") parsed.distribution = DelayDistribution::Uniform;
+                else if (value == "normal") parsed.distribution = DelayDistribution::Normal;
+                else if (value == "pareto") parsed.distribution = DelayDistribution::Pareto;
+                else ok = false;
+            }
+            else if (key == "delay") {
+                ok = parseNumber(value, 0, 60000, number);
+                parsed.delayMs = static_cast<int>(number);
+            }
+            else if (key == "jitter") {
+                ok = parseNumber(value, 0, 60000, number);
+                parsed.jitterMs = static_cast<int>(number);
+            }
+            else if (key == "loss") {
+                // Losing everything would never end a burst
+                ok = parseNumber(value, 0, 0.99, parsed.loss);
+            }
+            else if (key == "burst") {
+                ok = parseNumber(value, 1, 1000, parsed.lossBurst);
+            }
+            else if (key == "rto") {
+                ok = parseNumber(value, 1, 60000, number);
+                parsed.rtoMs = static_cast<int>(number);
+            }
+            else if (key == "mode") {
+                if (value == "reliable") parsed.unreliable = false;
+                else if (value == "unreliable") parsed.unreliable = true;
+                else ok = false;
+            }
+            else if (key == "reorder") {
+                ok = parseNumber(value, 0, 1, parsed.reorder);
+            }
+            else if (key == "duplicate") {
+                ok = parseNumber(value, 0, 1, parsed.duplicate);
+            }
+            else if (key == "bandwidth") {
+                ok = parseNumber(value, 0, 10000000, number);
+                parsed.bandwidthKbps = static_cast<int>(number);
+            }
+            else if (key == "seed") {
+                ok = parseNumber(value, 0, 4294967295.0, number);
+                parsed.seed = static_cast<uint32_t>(number);
+            }
+            else {
+                error = "unknown setting: " + key;
+                return false;
+            }
+            
+            if (!ok) {
+                error = "bad value for " + key + ": " + value;
+                return false;
+            }
+        }
+    }
+    
+    // A reliable link never shows either to its reader
+    if (!parsed.unreliable && (parsed.reorder > 0 || parsed.duplicate > 0)) {
+        error = "reorder and duplicate need mode=unreliable";
+        return false;
+    }
+    
+    profile = parsed;
+    return true;
+}
+
+std::string ImpairmentProfile::describe() const {
+    static const char* distributions[] = {"uniform", "normal", "pareto"};
+    
+    std::ostringstream out;
+    out << "delay " << delayMs;
+    if (jitterMs > 0) {
+        out << "+-" << jitterMs << " ms (" << distributions[static_cast<int>(distribution)] << ")";
+    } else {
+        out << " ms";
+    }
+    if (loss > 0) {
+        out << ", loss " << percent(loss);
+        if (lossBurst > 1) out << " (bursts of " << lossBurst << ")";
+        if (!unreliable) out << " resent after " << rtoMs << " ms";
+    }
+    if (unreliable) out << ", unreliable";
+    if (reorder > 0) out << ", reorder " << percent(reorder);
+    if (duplicate > 0) out << ", duplicate " << percent(duplicate);
+    if (bandwidthKbps > 0) out << ", " << bandwidthKbps << " kbit/s";
+    out << ", seed " << seed;
+    return out.str();
+}
+
+ImpairedTransport::ImpairedTransport(std::unique_ptr<Transport> inner, const ImpairmentProfile& profile,
+                                     std::shared_ptr<VirtualClock> clock)
+    : m_inner(std::move(inner)), m_profile(profile), m_clock(std::move(clock)) {
+    // Separate streams, so traffic one way does not change the fate of the other
+    m_outgoing.rng.seed(profile.seed);
+    m_incoming.rng.seed(profile.seed ^ 0x9E3779B9u);
+    
+    m_inner->setEventCallback([this](TransportEvent event, const std::string& data) {
+        onInnerEvent(event, data);
+    });
+}
+
+ImpairedTransport::~ImpairedTransport() {
+    // Its thread calls back into us, so it has to be quiet before we go
+    m_inner->stop();
+    
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+    }
+    m_cv.notify_all();
+    
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ImpairedTransport::setEventCallback(EventCallback callback) {
+    m_callback = std::move(callback);
+}
+
+void ImpairedTransport::start() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = true;
+        
+        // A new connection starts with an idle wire
+        TimePoint current = now();
+        m_outgoing.wireFreeAt = m_outgoing.lastDue = current;
+        m_incoming.wireFreeAt = m_incoming.lastDue = current;
+        m_outgoing.inBurst = m_incoming.inBurst = false;
+    }
+    
+    if (!m_clock && !m_thread.joinable()) {
+        m_thread = std::thread(&ImpairedTransport::deliveryLoop, this);
+    }
+    m_inner->start();
+}
+
+void ImpairedTransport::stop() {
+    m_inner->stop();
+    
+    std::vector<Pending> remaining;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        remaining.swap(m_queue);
+        m_outgoingBytes = 0;
+        m_stats.queued = 0;
+    }
+    m_cv.notify_all();
+    
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    
+    // Like the inner transport, report the link going down before returning;
+    // messages still in flight go down with it
+    std::sort(remaining.begin(), remaining.end(),
+        [](const Pending& a, const Pending& b) { return later(b, a); });
+    for (const auto& item : remaining) {
+        if (!item.outgoing && item.event != TransportEvent::Message && m_callback) {
+            m_callback(item.event, item.data);
+        }
+    }
+}
+
+bool ImpairedTransport::send(const std::string& message) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_running) return false;
+        
+        // A lost message still counts as sent, as on a real network
+        impair(m_outgoing, true, message);
+    }
+    m_cv.notify_all();
+    return true;
+}
+
+void ImpairedTransport::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        scheduleControl(m_outgoing, true, TransportEvent::Close, std::string());
+    }
+    m_cv.notify_all();
+}
+
+size_t ImpairedTransport::bufferedAmount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inner->bufferedAmount() + m_outgoingBytes;
+}
+
+void ImpairedTransport::deliverDue() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    while (!m_queue.empty() && m_queue.front().due <= now()) {
+        Pending item = pop();
+        lock.unlock();
+        deliver(item);
+        lock.lock();
+    }
+}
+
+ImpairedTransport::Stats ImpairedTransport::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::string ImpairedTransport::summary() const {
+    Stats stats = getStats();
+    
+    std::ostringstream out;
+    out << stats.messages << " messages, " << stats.dropped << " lost, " << stats.retransmitted
+        << " retransmitted, " << stats.duplicated << " duplicated, " << stats.reordered
+        << " reordered, peak " << stats.peakQueued << " in flight";
+    return out.str();
+}
+
+ImpairedTransport::TimePoint ImpairedTransport::now() const {
+    return m_clock ? m_clock->now() : std::chrono::steady_clock::now();
+}
+
+void ImpairedTransport::onInnerEvent(TransportEvent event, const std::string& data) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (event == TransportEvent::Message) {
+            impair(m_incoming, false, data);
+        } else {
+            scheduleControl(m_incoming, false, event, data);
+        }
+    }
+    m_cv.notify_all();
+}
+
+void ImpairedTransport::impair(Link& link, bool outgoing, const std::string& data) {
+    m_stats.messages++;
+    
+    // Reliable: each loss is a retransmission timeout, doubled on every retry
+    std::chrono::microseconds stall{0};
+    if (m_profile.unreliable) {
+        if (lose(link)) {
+            m_stats.dropped++;
+            return;
+        }
+    } else {
+        std::chrono::microseconds rto = std::chrono::milliseconds(m_profile.rtoMs);
+        for (int attempt = 0; attempt < MAX_RETRANSMITS && lose(link); attempt++) {
+            stall += rto;
+            rto *= 2;
+            m_stats.retransmitted++;
+        }
+    }
+    
+    int copies = 1;
+    if (m_profile.unreliable && m_profile.duplicate > 0 && unit(link) < m_profile.duplicate) {
+        copies = 2;
+        m_stats.duplicated++;
+    }
+    
+    for (int copy = 0; copy < copies; copy++) {
+        TimePoint sent = now();
+        
+        // The wire sends one message at a time, so a burst queues up behind it
+        if (m_profile.bandwidthKbps > 0) {
+            auto serialization = std::chrono::microseconds(
+                static_cast<int64_t>(data.size()) * 8 * 1000 / m_profile.bandwidthKbps);
+            link.wireFreeAt = std::max(sent, link.wireFreeAt) + serialization;
+            sent = link.wireFreeAt;
+        }
+        
+        // Later messages wait for a stalled one through lastDue
+        TimePoint due = sent + sampleDelay(link) + stall;
+        if (m_profile.unreliable && m_profile.reorder > 0 && unit(link) < m_profile.reorder) {
+            due = sent;
+            m_stats.reordered++;
+        } else {
+            due = std::max(due, link.lastDue);
+            link.lastDue = due;
+        }
+        
+        if (outgoing) {
+            m_outgoingBytes += data.size();
+        }
+        push(due, outgoing, TransportEvent::Message, data);
+    }
+}
+
+void ImpairedTransport::scheduleControl(Link& link, bool outgoing, TransportEvent event,
+                                        const std::string& data) {
+    TimePoint due = std::max(now(), link.lastDue);
+    link.lastDue = due;
+    push(due, outgoing, event, data);
+}
+
+void ImpairedTransport::push(TimePoint due, bool outgoing, TransportEvent event, const std::string& data) {
+    m_queue.push_back({due, m_nextOrder++, outgoing, event, data});
+    std::push_heap(m_queue.begin(), m_queue.end(), later);
+    
+    m_stats.queued = m_queue.size();
+    m_stats.peakQueued = std::max(m_stats.peakQueued, m_stats.queued);
+}
+
+ImpairedTransport::Pending ImpairedTransport::pop() {
+    std::pop_heap(m_queue.begin(), m_queue.end(), later);
+    Pending item = std::move(m_queue.back());
+    m_queue.pop_back();
+    
+    m_stats.queued = m_queue.size();
+    if (item.outgoing) {
+        m_outgoingBytes -= item.data.size();
+    }
+    return item;
+}
+
+bool ImpairedTransport::lose(Link& link) {
+    if (m_profile.loss <= 0) return false;
+    
+    if (m_profile.lossBurst <= 1) {
+        return unit(link) < m_profile.loss;
+    }
+    
+    // Two-state model: bursts end with probability 1/burst per message, and
+    // start just often enough that the long-run loss rate is 'loss'
+    double leave = 1.0 / m_profile.lossBurst;
+    double enter = leave * m_profile.loss / (1.0 - m_profile.loss);
+    link.inBurst = link.inBurst ? unit(link) >= leave : unit(link) < enter;
+    return link.inBurst;
+}
+
+std::chrono::microseconds ImpairedTransport::sampleDelay(Link& link) {
+    double jitter = 0;
+    
+    if (m_profile.jitterMs > 0) {
+        switch (m_profile.distribution) {
+            case DelayDistribution::Uniform:
+                jitter = (2 * unit(link) - 1) * m_profile.jitterMs;
+                break;
+            case DelayDistribution::Normal:
+            {
+                // Box-Muller: std::normal_distribution differs between standard libraries
+                double u1 = unit(link);
+                double u2 = unit(link);
+                jitter = std::sqrt(-2 * std::log(u1)) * std::cos(2 * PI * u2) * m_profile.jitterMs;
+                break;
+            }
+            case DelayDistribution::Pareto:
+                // Shape 3, scaled so the mean is jitterMs
+                jitter = (std::pow(unit(link), -1.0 / 3.0) - 1) * 2 * m_profile.jitterMs;
+                break;
+        }
+    }
+    
+    double delayMs = std::max(0.0, m_profile.delayMs + jitter);
+    return std::chrono::microseconds(static_cast<int64_t>(delayMs * 1000));
+}
+
+void ImpairedTransport::deliveryLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    
+    while (m_running) {
+        if (m_queue.empty()) {
+            m_cv.wait(lock);
+            continue;
+        }
+        
+        TimePoint due = m_queue.front().due;
+        if (due > now()) {
+            m_cv.wait_until(lock, due);
+            continue;
+        }
+        
+        Pending item = pop();
+        lock.unlock();
+        deliver(item);
+        lock.lock();
+    }
+}
+
+void ImpairedTransport::deliver(const Pending& item) {
+    if (!item.outgoing) {
+        if (m_callback) {
+            m_callback(item.event, item.data);
+        }
+    } else if (item.event == TransportEvent::Close) {
+        m_inner->close();
+    } else {
+        m_inner->send(item.data);
+    }
+}
+
+double ImpairedTransport::unit(Link& link) {
+    // Open interval (0, 1) straight from the generator; the std distributions
+    // would make results depend on the standard library
+    return (link.rng() + 0.5) / 4294967296.0;
+}
+
+bool ImpairedTransport::later(const Pending& a, const Pending& b) {
+    return a.due != b.due ? a.due > b.due : a.order > b.order;
+}
+
+} // namespace GameAway
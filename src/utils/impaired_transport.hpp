@@ -0,0 +1,165 @@
+#pragma once
+
+#include "transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace GameAway {
+
+// Shape of the jitter added to the base delay
+enum class DelayDistribution {
+    Uniform,   // Evenly within +-jitter
+    Normal,    // Standard deviation of jitter
+    Pareto     // Mostly small with a long tail; mean of jitter
+};
+
+// Network conditions to simulate, applied to each direction on its own.
+// Written as key=value settings, '#' starts a comment:
+//
+//   delay=40 jitter=15 distribution=normal   Milliseconds
+//   loss=0.02 burst=3                        2% lost, in runs of 3 on average
+//   rto=300                                  Milliseconds before a lost message is resent
+//   mode=unreliable                          Lost messages vanish instead
+//   reorder=0.01 duplicate=0.001             Fractions of messages; unreliable only
+//   bandwidth=2000                           kbit/s, 0 for no cap
+//   seed=7                                   Same seed, same outcome
+//
+// The default reliable mode behaves like the TCP under every real transport:
+// a lost message arrives a retransmission timeout late, doubled for each
+// time it is lost again, and everything sent after it waits behind it.
+struct ImpairmentProfile {
+    int delayMs = 0;
+    int jitterMs = 0;
+    DelayDistribution distribution = DelayDistribution::Uniform;
+    double loss = 0.0;
+    double lossBurst = 1.0;    // Mean run length of lost messages; 1 = independent losses
+    int rtoMs = 300;           // Windows' minimum retransmission timeout
+    bool unreliable = false;
+    double reorder = 0.0;      // These skip the delay and overtake earlier messages
+    double duplicate = 0.0;
+    int bandwidthKbps = 0;
+    uint32_t seed = 1;
+    
+    // On an unknown key or bad value, returns false and names it in 'error'
+    static bool parse(const std::string& text, ImpairmentProfile& profile, std::string& error);
+    
+    // e.g. "delay 40+-15 ms (normal), loss 2% (bursts of 3) resent after 300 ms, seed 7"
+    std::string describe() const;
+};
+
+// Time source for ImpairedTransport that only moves when advanced, so a
+// scenario plays out identically on every run
+class VirtualClock {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    
+    TimePoint now() const { return TimePoint(std::chrono::microseconds(m_nowUs.load())); }
+    void advance(std::chrono::microseconds step) { m_nowUs.fetch_add(step.count()); }
+
+private:
+    std::atomic<int64_t> m_nowUs{0};
+};
+
+// Wraps another transport and delays, stalls or drops, reorders, duplicates
+// and rate-limits its messages in both directions, to reproduce a WAN link on
+// one machine. Every random choice comes from a generator seeded by the
+// profile, so the same messages give the same outcome. With a VirtualClock
+// nothing happens on its own: the owner advances the clock and calls
+// deliverDue(). Otherwise a thread delivers in real time.
+//
+// Open, Close and Error are never lost, and never overtake messages
+// queued before them.
+class ImpairedTransport : public Transport {
+public:
+    ImpairedTransport(std::unique_ptr<Transport> inner, const ImpairmentProfile& profile,
+                      std::shared_ptr<VirtualClock> clock = nullptr);
+    ~ImpairedTransport() override;
+    
+    void setEventCallback(EventCallback callback) override;
+    void start() override;
+    void stop() override;
+    bool send(const std::string& message) override;
+    void close() override;
+    
+    // Includes messages held back by the simulated link
+    size_t bufferedAmount() const override;
+    
+    // Deliver everything due by now (VirtualClock only)
+    void deliverDue();
+    
+    struct Stats {
+        uint64_t messages;        // Offered, both directions
+        uint64_t dropped;
+        uint64_t retransmitted;   // Reliable mode: losses delivered late instead
+        uint64_t duplicated;
+        uint64_t reordered;
+        size_t queued;            // In flight right now
+        size_t peakQueued;
+    };
+    Stats getStats() const;
+    
+    // e.g. "12000 messages, 240 lost, 0 retransmitted, 12 duplicated, 120 reordered, peak 35 in flight"
+    std::string summary() const;
+
+private:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    
+    // One direction of the simulated link
+    struct Link {
+        std::mt19937 rng;
+        bool inBurst = false;     // Loss model: losing every message until the burst ends
+        TimePoint wireFreeAt{};   // Bandwidth cap: when the wire has sent what is queued
+        TimePoint lastDue{};      // Messages that are not reordered keep their order
+    };
+    
+    struct Pending {
+        TimePoint due;
+        uint64_t order;           // Breaks ties in queueing order
+        bool outgoing;
+        TransportEvent event;     // Close on an outgoing entry closes the inner transport
+        std::string data;
+    };
+    
+    std::unique_ptr<Transport> m_inner;
+    ImpairmentProfile m_profile;
+    std::shared_ptr<VirtualClock> m_clock;
+    EventCallback m_callback;
+    
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Pending> m_queue;   // Heap, earliest due first
+    Link m_outgoing;
+    Link m_incoming;
+    uint64_t m_nextOrder = 0;
+    size_t m_outgoingBytes = 0;
+    Stats m_stats{};
+    std::thread m_thread;
+    bool m_running = false;
+    
+    TimePoint now() const;
+    void onInnerEvent(TransportEvent event, const std::string& data);
+    
+    // m_mutex held
+    void impair(Link& link, bool outgoing, const std::string& data);
+    void scheduleControl(Link& link, bool outgoing, TransportEvent event, const std::string& data);
+    void push(TimePoint due, bool outgoing, TransportEvent event, const std::string& data);
+    Pending pop();
+    bool lose(Link& link);
+    std::chrono::microseconds sampleDelay(Link& link);
+    
+    void deliveryLoop();
+    void deliver(const Pending& item);
+    
+    static double unit(Link& link);
+    static bool later(const Pending& a, const Pending& b);
+};
+
+} // namespace GameAway
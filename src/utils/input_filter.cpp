@@ -0,0 +1,417 @@
+#include "input_filter.hpp"
+#include <Windows.h>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace GameAway {
+
+namespace {
+
+// Bits of InputFilter::m_modifierKeys
+enum ModifierKey : uint8_t {
+    LeftCtrl = 1 << 0,
+    RightCtrl = 1 << 1,
+    LeftShift = 1 << 2,
+    RightShift = 1 << 3,
+    LeftAlt = 1 << 4,
+    RightAlt = 1 << 5,
+    LeftWin = 1 << 6,
+    RightWin = 1 << 7
+};
+
+uint8_t modifierKeyBit(int vk) {
+    switch (vk) {
+        case VK_CONTROL: case VK_LCONTROL: return LeftCtrl;
+        case VK_RCONTROL: return RightCtrl;
+        case VK_SHIFT: case VK_LSHIFT: return LeftShift;
+        case VK_RSHIFT: return RightShift;
+        case VK_MENU: case VK_LMENU: return LeftAlt;
+        case VK_RMENU: return RightAlt;
+        case VK_LWIN: return LeftWin;
+        case VK_RWIN: return RightWin;
+        default: return 0;
+    }
+}
+
+// Row of InputFilter::m_scan: the low byte, plus 0x100 for an 0xE0 prefix
+int scanIndex(int scanCode) {
+    return (scanCode & 0xFF) | ((scanCode & 0xFF00) == 0xE000 ? 0x100 : 0);
+}
+
+enum class Category {
+    None,
+    Key,
+    Button,
+    Wheel,
+    Move,
+    Gamepad
+};
+
+struct Rule {
+    InputFilter::Action action = InputFilter::Unset;
+    Category category = Category::None;
+    std::vector<int> vks;
+    std::vector<int> scans;
+    std::vector<int> buttons;
+    int mods = -1;      // -1: any set
+    int target = -1;
+    std::string targetText;   // Resolved once the category is known
+};
+
+// Hex (0x5B) or decimal; for virtual keys also a single letter or digit
+bool parseCode(const std::string& text, int limit, bool keyName, int& code) {
+    if (keyName && text.size() == 1 && std::isalnum(static_cast<unsigned char>(text[0]))) {
+        code = std::toupper(static_cast<unsigned char>(text[0]));
+        return code < limit;
+    }
+    
+    try {
+        size_t used = 0;
+        code = std::stoi(text, &used, 0);
+        return used == text.size() && code >= 0 && code < limit;
+    } catch (...) {
+        return false;
+    }
+}
+
+bool parseCodes(const std::string& text, int limit, bool keyName, std::vector<int>& codes) {
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        int code;
+        if (!parseCode(item, limit, keyName, code)) return false;
+        codes.push_back(code);
+    }
+    return !codes.empty();
+}
+
+// Scan codes as 0x00-0xFF or 0xE000-0xE0FF, stored as scanIndex() rows
+bool parseScanCodes(const std::string& text, std::vector<int>& scans) {
+    std::vector<int> codes;
+    if (!parseCodes(text, 0xE100, false, codes)) return false;
+    
+    for (int code : codes) {
+        if (code > 0xFF && (code & 0xFF00) != 0xE000) return false;
+        scans.push_back(scanIndex(code));
+    }
+    return true;
+}
+
+// Same bits as RegisterHotKey's MOD_* flags
+bool parseMods(const std::string& text, int& mods) {
+    mods = 0;
+    if (text == "none") return true;
+    
+    std::istringstream in(text);
+    std::string item;
+    while (std::getline(in, item, '+')) {
+        if (item == "ctrl") mods |= MOD_CONTROL;
+        else if (item == "shift") mods |= MOD_SHIFT;
+        else if (item == "alt") mods |= MOD_ALT;
+        else if (item == "win") mods |= MOD_WIN;
+        else return false;
+    }
+    return true;
+}
+
+bool parseCategory(const std::string& text, Category& category) {
+    if (text == "key") category = Category::Key;
+    else if (text == "button") category = Category::Button;
+    else if (text == "wheel") category = Category::Wheel;
+    else if (text == "move") category = Category::Move;
+    else if (text == "gamepad") category = Category::Gamepad;
+    else return false;
+    return true;
+}
+
+// Empty string on success, otherwise what is wrong with the line
+std::string parseRule(const std::string& line, Rule& rule) {
+    std::istringstream in(line);
+    std::string word;
+    in >> word;
+    
+    if (word == "allow") rule.action = InputFilter::Allow;
+    else if (word == "deny") rule.action = InputFilter::Deny;
+    else if (word == "remap") rule.action = InputFilter::Remap;
+    else return "unknown action '" + word + "'";
+    
+    while (in >> word) {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) return "expected key=value, got '" + word + "'";
+        
+        std::string key = word.substr(0, eq);
+        std::string value = word.substr(eq + 1);
+        bool ok;
+        
+        if (key == "vk") ok = parseCodes(value, 256, true, rule.vks);
+        else if (key == "sc") ok = parseScanCodes(value, rule.scans);
+        else if (key == "button") ok = parseCodes(value, 3, false, rule.buttons);
+        else if (key == "mods") ok = parseMods(value, rule.mods);
+        else if (key == "type") ok = parseCategory(value, rule.category);
+        else if (key == "to") ok = !(rule.targetText = value).empty();
+        else return "unknown selector '" + key + "'";
+        
+        if (!ok) return "bad value in '" + word + "'";
+    }
+    
+    // Codes imply the category when type= is left out
+    if (rule.category == Category::None) {
+        if (!rule.vks.empty() || !rule.scans.empty()) rule.category = Category::Key;
+        else if (!rule.buttons.empty()) rule.category = Category::Button;
+        else return "rule matches nothing (add vk=, sc=, button= or type=)";
+    }
+    
+    bool keyCodes = !rule.vks.empty() || !rule.scans.empty();
+    if (keyCodes && rule.category != Category::Key) return "vk= and sc= only apply to keys";
+    if (!rule.buttons.empty() && rule.category != Category::Button) return "button= only applies to buttons";
+    if (rule.category == Category::Gamepad && rule.mods >= 0) return "mods= does not apply to gamepad";
+    
+    bool remap = rule.action == InputFilter::Remap;
+    if (remap == rule.targetText.empty()) return remap ? "remap needs to=" : "to= only applies to remap";
+    if (!remap) return std::string();
+    
+    if (rule.category == Category::Key) {
+        if (!parseCode(rule.targetText, 256, true, rule.target)) return "bad key in to=";
+    } else if (rule.category == Category::Button) {
+        if (!parseCode(rule.targetText, 3, false, rule.target)) return "button target must be 0-2";
+    } else {
+        return "only keys and buttons can be remapped";
+    }
+    return std::string();
+}
+
+} // namespace
+
+InputFilter::InputFilter() {
+    std::string error;
+    compile(std::string(), error);
+    
+    for (auto& pressed : m_pressedKeys) pressed.store(0);
+    for (auto& pressed : m_pressedButtons) pressed.store(0);
+}
+
+const char* InputFilter::defaultRules() {
+    return
+        "# Input rules: one per line, later lines override earlier ones.\n"
+        "#   allow|deny|remap  vk=<codes> | sc=<codes> | button=<0-2> | type=key|button|wheel|move|gamepad\n"
+        "#                     [mods=ctrl+shift+alt+win|none] [to=<code>]\n"
+        "# Codes are hex (0x5B), decimal, or a single letter or digit; extended\n"
+        "# scan codes keep their prefix (sc=0xE05B).\n"
+        "\n"
+        "# Hotkeys (pause, paste, focus) stay on the PC they were pressed on\n"
+        "deny vk=P mods=ctrl+shift\n"
+        "deny vk=V mods=ctrl+shift\n"
+        "deny vk=F mods=ctrl+shift\n"
+        "\n"
+        "# Examples:\n"
+        "# deny vk=0x5B,0x5C                      Windows keys\n"
+        "# deny vk=0xAD,0xAE,0xAF,0xB0,0xB1,0xB2,0xB3  Volume and media keys\n"
+        "# remap vk=0x14 to=0xA2                  Caps Lock acts as Left Ctrl\n";
+}
+
+bool InputFilter::compile(const std::string& rules, std::string& error) {
+    std::vector<Rule> parsed;
+    
+    std::istringstream in(rules);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        ++lineNumber;
+        
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        
+        Rule rule;
+        std::string problem = parseRule(line, rule);
+        if (!problem.empty()) {
+            error = "line " + std::to_string(lineNumber) + ": " + problem;
+            return false;
+        }
+        parsed.push_back(std::move(rule));
+    }
+    
+    for (auto& row : m_vk) for (auto& cell : row) cell = Entry{};
+    for (auto& row : m_scan) for (auto& cell : row) cell = Entry{};
+    for (auto& row : m_button) for (auto& cell : row) cell = Entry{};
+    for (auto& cell : m_wheel) cell = Entry{};
+    for (auto& cell : m_move) cell = Entry{};
+    for (auto& cell : m_gamepad) cell = Entry{};
+    m_scanRules.reset();
+    
+    // Expand each rule over its codes and modifier sets; later rules overwrite
+    for (const Rule& rule : parsed) {
+        Entry entry{rule.action, 0, 0};
+        if (rule.target >= 0) {
+            entry.code = static_cast<uint8_t>(rule.target);
+            if (rule.category == Category::Key) {
+                entry.scan = static_cast<uint16_t>(MapVirtualKeyW(rule.target, MAPVK_VK_TO_VSC_EX));   // Keeps the 0xE0 prefix
+            }
+        }
+        
+        int firstMods = rule.mods < 0 ? 0 : rule.mods;
+        int lastMods = rule.mods < 0 ? MODIFIER_SETS - 1 : rule.mods;
+        
+        for (int mods = firstMods; mods <= lastMods; ++mods) {
+            switch (rule.category) {
+                case Category::Key:
+                    if (rule.vks.empty() && rule.scans.empty()) {
+                        for (auto& row : m_vk) row[mods] = entry;
+                    }
+                    for (int vk : rule.vks) m_vk[vk][mods] = entry;
+                    for (int scan : rule.scans) {
+                        m_scan[scan][mods] = entry;
+                        m_scanRules.set(scan);
+                    }
+                    break;
+                case Category::Button:
+                    if (rule.buttons.empty()) {
+                        for (auto& row : m_button) row[mods] = entry;
+                    }
+                    for (int button : rule.buttons) m_button[button][mods] = entry;
+                    break;
+                case Category::Wheel:
+                    m_wheel[mods] = entry;
+                    break;
+                case Category::Move:
+                    m_move[mods] = entry;
+                    break;
+                case Category::Gamepad:
+                    m_gamepad[mods] = entry;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    m_ruleCount = parsed.size();
+    return true;
+}
+
+bool InputFilter::load(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        std::ofstream out(path, std::ios::trunc);
+        out << defaultRules();
+        return compile(defaultRules(), error);
+    }
+    
+    std::stringstream rules;
+    rules << in.rdbuf();
+    return compile(rules.str(), error);
+}
+
+int InputFilter::modifierSet() const {
+    uint8_t keys = m_modifierKeys.load(std::memory_order_relaxed);
+    int mods = 0;
+    if (keys & (LeftCtrl | RightCtrl)) mods |= MOD_CONTROL;
+    if (keys & (LeftShift | RightShift)) mods |= MOD_SHIFT;
+    if (keys & (LeftAlt | RightAlt)) mods |= MOD_ALT;
+    if (keys & (LeftWin | RightWin)) mods |= MOD_WIN;
+    return mods;
+}
+
+void InputFilter::trackModifier(const InputEvent& event) {
+    uint8_t bit = modifierKeyBit(event.vkCode);
+    if (bit == 0) return;
+    
+    if (event.type == InputEventType::KeyDown) {
+        m_modifierKeys.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        m_modifierKeys.fetch_and(static_cast<uint8_t>(~bit), std::memory_order_relaxed);
+    }
+}
+
+InputFilter::Entry InputFilter::resolveKey(int vk, int scanCode, int mods) const {
+    int scan = scanIndex(scanCode);
+    if (m_scanRules.test(scan) && m_scan[scan][mods].action != Unset) {
+        return m_scan[scan][mods];
+    }
+    return m_vk[vk & 0xFF][mods];
+}
+
+bool InputFilter::applyEntry(const Entry& entry, InputEvent& event) {
+    switch (entry.action) {
+        case Deny:
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        case Remap:
+            if (event.type == InputEventType::KeyDown || event.type == InputEventType::KeyUp) {
+                event.vkCode = entry.code;
+                event.scanCode = entry.scan;
+            } else {
+                event.button = entry.code;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+bool InputFilter::apply(InputEvent& event) {
+    switch (event.type) {
+        case InputEventType::KeyDown:
+        {
+            // Modifiers held before this press, not including itself
+            int mods = modifierSet();
+            trackModifier(event);
+            
+            Entry entry = resolveKey(event.vkCode, event.scanCode, mods);
+            m_pressedKeys[event.vkCode & 0xFF].store(pack(entry) + 1, std::memory_order_relaxed);
+            return applyEntry(entry, event);
+        }
+        case InputEventType::KeyUp:
+        {
+            trackModifier(event);
+            
+            // Same outcome as the press, whatever the modifiers are now
+            uint32_t pressed = m_pressedKeys[event.vkCode & 0xFF].exchange(0, std::memory_order_relaxed);
+            Entry entry = pressed ? unpack(pressed - 1) : resolveKey(event.vkCode, event.scanCode, modifierSet());
+            return applyEntry(entry, event);
+        }
+        case InputEventType::MouseButtonDown:
+        case InputEventType::MouseButtonUp:
+        {
+            if (event.button < 0 || event.button >= BUTTONS) return true;
+            
+            auto& pressed = m_pressedButtons[event.button];
+            Entry entry;
+            if (event.type == InputEventType::MouseButtonDown) {
+                entry = m_button[event.button][modifierSet()];
+                pressed.store(pack(entry) + 1, std::memory_order_relaxed);
+            } else {
+                uint32_t previous = pressed.exchange(0, std::memory_order_relaxed);
+                entry = previous ? unpack(previous - 1) : m_button[event.button][modifierSet()];
+            }
+            return applyEntry(entry, event);
+        }
+        case InputEventType::MouseWheel:
+            return applyEntry(m_wheel[modifierSet()], event);
+        case InputEventType::MouseMove:
+            return applyEntry(m_move[modifierSet()], event);
+        case InputEventType::GamepadButtons:
+        case InputEventType::GamepadAxes:
+            // Gamepad rules never carry mods, so every set holds the same entry
+            return applyEntry(m_gamepad[0], event);
+        default:
+            return true;
+    }
+}
+
+uint32_t InputFilter::pack(const Entry& entry) {
+    return static_cast<uint32_t>(entry.action) | static_cast<uint32_t>(entry.code) << 8 |
+           static_cast<uint32_t>(entry.scan) << 16;
+}
+
+InputFilter::Entry InputFilter::unpack(uint32_t packed) {
+    Entry entry;
+    entry.action = static_cast<uint8_t>(packed & 0xFF);
+    entry.code = static_cast<uint8_t>(packed >> 8 & 0xFF);
+    entry.scan = static_cast<uint16_t>(packed >> 16);
+    return entry;
+}
+
+} // namespace GameAway
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "client/input_hook.hpp"
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <string>
+
+namespace GameAway {
+
+// Allow/deny/remap rules for captured input, compiled into flat tables so
+// checking an event is a couple of array lookups. Both ends apply their own
+// rules file: the client before anything is serialized, the server again
+// before replay. One rule per line, later rules override earlier ones:
+//
+//   deny vk=0x5B,0x5C                  Win keys
+//   deny vk=P mods=ctrl+shift          A hotkey chord
+//   remap vk=0x14 to=0xA2              Caps Lock types Left Ctrl
+//   deny sc=0x3A                       By scan code (checked before vk)
+//   deny sc=0xE05B                     Extended keys with their 0xE0 prefix
+//   remap button=2 to=0                Middle click becomes left click
+//   deny type=wheel mods=ctrl          Also move, gamepad
+//
+// mods= matches the exact set of Ctrl/Shift/Alt/Win held, tracked from the
+// key events seen here; without it a rule matches any set. A release always
+// gets the same treatment as its press, so a remapped or dropped press never
+// leaves the other end with an unmatched key.
+class InputFilter {
+public:
+    enum Action : uint8_t {
+        Unset,    // No rule; allowed as is
+        Allow,
+        Deny,
+        Remap
+    };
+    
+    InputFilter();
+    
+    // Compile rules text; on error the previous rules stay and 'error' names the line
+    bool compile(const std::string& rules, std::string& error);
+    
+    // Load a rules file, writing the defaults there first if it does not exist
+    bool load(const std::string& path, std::string& error);
+    
+    // Filter an event in place (remaps change its codes); false means drop it.
+    // Safe to call from several threads.
+    bool apply(InputEvent& event);
+    
+    size_t getRuleCount() const { return m_ruleCount; }
+    uint64_t getDropped() const { return m_dropped.load(); }
+    
+    // Rules used when no rules file exists: the client's own hotkeys
+    static const char* defaultRules();
+
+private:
+    // One table cell: packed into 32 bits so pressed keys can keep theirs atomically
+    struct Entry {
+        uint8_t action;
+        uint8_t code;     // Remap target (vk or button)
+        uint16_t scan;    // Scan code of a remapped key
+    };
+    
+    static constexpr int MODIFIER_SETS = 16;   // MOD_ALT | MOD_CONTROL | MOD_SHIFT | MOD_WIN
+    static constexpr int BUTTONS = 3;
+    static constexpr int SCAN_CODES = 512;     // 0x00-0xFF, then the same with the 0xE0 prefix
+    
+    Entry m_vk[256][MODIFIER_SETS];
+    Entry m_scan[SCAN_CODES][MODIFIER_SETS];
+    Entry m_button[BUTTONS][MODIFIER_SETS];
+    Entry m_wheel[MODIFIER_SETS];
+    Entry m_move[MODIFIER_SETS];
+    Entry m_gamepad[MODIFIER_SETS];
+    std::bitset<SCAN_CODES> m_scanRules;   // Scan codes with any rule; the rest go by vk
+    size_t m_ruleCount = 0;
+    
+    // Physical modifier keys held (left/right kept apart so releasing one
+    // side does not clear the other)
+    std::atomic<uint8_t> m_modifierKeys{0};
+    
+    // What each currently pressed key and button got on its press, as a
+    // packed Entry plus one; zero when not pressed
+    std::atomic<uint32_t> m_pressedKeys[256];
+    std::atomic<uint32_t> m_pressedButtons[BUTTONS];
+    
+    std::atomic<uint64_t> m_dropped{0};
+    
+    int modifierSet() const;
+    void trackModifier(const InputEvent& event);
+    Entry resolveKey(int vk, int scanCode, int mods) const;
+    bool applyEntry(const Entry& entry, InputEvent& event);
+    
+    static uint32_t pack(const Entry& entry);
+    static Entry unpack(uint32_t packed);
+};
+
+} // namespace GameAway
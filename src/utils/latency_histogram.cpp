@@ -0,0 +1,85 @@
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace GameAway {
+
+namespace {
+
+constexpr int SUB_BITS = LatencyHistogram::SUB_BITS;
+constexpr int SUB_BUCKETS = LatencyHistogram::SUB_BUCKETS;
+
+// Below SUB_BUCKETS each value has its own bucket. Above, the value's
+// highest set bit picks a group and the next SUB_BITS bits a bucket in it.
+int bucketFor(int64_t latencyMs) {
+    if (latencyMs < SUB_BUCKETS) return static_cast<int>(latencyMs);
+    
+    int exponent = SUB_BITS;
+    while (exponent < LatencyHistogram::MAX_EXPONENT - 1 && (latencyMs >> (exponent + 1)) != 0) {
+        ++exponent;
+    }
+    if ((latencyMs >> (exponent + 1)) != 0) return LatencyHistogram::BUCKETS - 1;
+    
+    int sub = static_cast<int>(latencyMs >> (exponent - SUB_BITS)) - SUB_BUCKETS;
+    return SUB_BUCKETS * (exponent - SUB_BITS + 1) + sub;
+}
+
+// Largest value that lands in the bucket
+int64_t upperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    int64_t sub = bucket % SUB_BUCKETS;
+    int64_t width = int64_t{1} << (exponent - SUB_BITS);
+    return (SUB_BUCKETS + sub) * width + width - 1;
+}
+
+} // namespace
+
+void LatencyHistogram::record(int64_t latencyMs) {
+    if (latencyMs < 0) latencyMs = 0;
+    
+    m_buckets[bucketFor(latencyMs)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    
+    int64_t max = m_maxMs.load(std::memory_order_relaxed);
+    while (latencyMs > max && !m_maxMs.compare_exchange_weak(max, latencyMs, std::memory_order_relaxed)) {
+        // 'max' now holds the current value; retry while ours is still larger
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0);
+    }
+    m_count.store(0);
+    m_maxMs.store(0);
+}
+
+int64_t LatencyHistogram::percentileMs(double fraction) const {
+    uint64_t total = m_count.load();
+    if (total == 0) return 0;
+    
+    uint64_t target = static_cast<uint64_t>(fraction * total);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            // The last bucket is open-ended
+            return i == BUCKETS - 1 ? m_maxMs.load() : std::min(upperBound(i), m_maxMs.load());
+        }
+    }
+    return m_maxMs.load();
+}
+
+std::string LatencyHistogram::summary() const {
+    std::ostringstream out;
+    out << "n=" << count()
+        << " p50<=" << percentileMs(0.50) << "ms"
+        << " p95<=" << percentileMs(0.95) << "ms"
+        << " p99<=" << percentileMs(0.99) << "ms"
+        << " max=" << maxMs() << "ms";
+    return out.str();
+}
+
+} // namespace GameAway
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace GameAway {
+
+// Lock-free latency histogram in milliseconds, the resolution event
+// timestamps are captured at, cheap enough to record every replayed event
+// from any thread. Buckets are log-linear: exact below SUB_BUCKETS ms, then
+// SUB_BUCKETS per power of two, so a percentile reported as its bucket's
+// upper bound overstates the true value by at most 1/SUB_BUCKETS.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+    static constexpr int MAX_EXPONENT = 21;   // Up to ~35 minutes; larger values land in the last bucket
+    static constexpr int BUCKETS = SUB_BUCKETS * (MAX_EXPONENT - SUB_BITS + 1);
+    
+    void record(int64_t latencyMs);
+    void reset();
+    
+    uint64_t count() const { return m_count.load(); }
+    int64_t maxMs() const { return m_maxMs.load(); }
+    
+    // Upper bound of the bucket holding the given fraction (0..1) of samples
+    int64_t percentileMs(double fraction) const;
+    
+    // One-line summary, e.g. "n=1200 p50<=2ms p95<=4ms p99<=8ms max=11ms"
+    std::string summary() const;
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKETS] = {};
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<int64_t> m_maxMs{0};
+};
+
+} // namespace GameAway
@@ -0,0 +1,320 @@
+#include "logger.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace GameAway {
+
+static_assert((LOG_THREAD_BUFFER & (LOG_THREAD_BUFFER - 1)) == 0, "LOG_THREAD_BUFFER must be a power of two");
+
+namespace {
+
+struct LogRecord {
+    uint64_t seq;         // Global order across threads
+    uint64_t timeUs;      // Wall clock, microseconds since the epoch
+    LogLevel level;
+    uint16_t length;
+    char text[LOG_MAX_MESSAGE];
+};
+
+// Ring owned by one producing thread: only it advances head, only the
+// writer advances tail
+struct ThreadBuffer {
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    LogRecord records[LOG_THREAD_BUFFER];
+};
+
+// Console flood control for one message text
+struct RepeatState {
+    std::chrono::steady_clock::time_point windowStart;
+    int count = 0;
+    uint64_t suppressed = 0;
+};
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Error: return "ERROR";
+    }
+    return "INFO";
+}
+
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+    
+    void start(LogLevel minLevel, const std::string& binaryLogPath) {
+        if (m_running.load()) return;
+        
+        m_minLevel.store(minLevel);
+        
+        if (!binaryLogPath.empty()) {
+            m_binaryLog.open(binaryLogPath, std::ios::binary | std::ios::app);
+            if (m_binaryLog) {
+                m_binaryLog.write("GALOG1\0\0", 8);
+            }
+        }
+        
+        m_running.store(true);
+        m_thread = std::thread(&Logger::writerLoop, this);
+    }
+    
+    void stop() {
+        if (!m_running.exchange(false)) return;
+        
+        wake();
+        m_thread.join();
+        
+        if (m_binaryLog.is_open()) {
+            m_binaryLog.close();
+        }
+    }
+    
+    void log(LogLevel level, const std::string& message) {
+        if (level < m_minLevel.load(std::memory_order_relaxed)) return;
+        
+        if (!m_running.load(std::memory_order_acquire)) {
+            std::cout << "\n[" << levelName(level) << "] " << message << std::endl;
+            return;
+        }
+        
+        ThreadBuffer& buffer = threadBuffer();
+        uint32_t head = buffer.head.load(std::memory_order_relaxed);
+        
+        // Never wait for the writer; losing a line beats stalling input
+        if (head - buffer.tail.load(std::memory_order_acquire) >= LOG_THREAD_BUFFER) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        
+        LogRecord& record = buffer.records[head % LOG_THREAD_BUFFER];
+        record.seq = m_nextSeq.fetch_add(1, std::memory_order_relaxed);
+        record.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        record.level = level;
+        record.length = static_cast<uint16_t>(std::min<size_t>(message.size(), LOG_MAX_MESSAGE));
+        std::memcpy(record.text, message.data(), record.length);
+        
+        buffer.head.store(head + 1, std::memory_order_release);
+        
+        // Wake the writer once per batch, not once per line
+        if (!m_pending.exchange(true)) {
+            wake();
+        }
+    }
+    
+    uint64_t dropped() const {
+        return m_dropped.load();
+    }
+    
+    size_t threadBuffers() {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        return m_buffers.size();
+    }
+
+private:
+    std::mutex m_registryMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_pending{false};
+    std::atomic<LogLevel> m_minLevel{LogLevel::Info};
+    std::atomic<uint64_t> m_nextSeq{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCv;
+    bool m_wake = false;
+    std::thread m_thread;
+    
+    // Writer thread only
+    std::ofstream m_binaryLog;
+    std::unordered_map<std::string, RepeatState> m_repeats;
+    uint64_t m_droppedReported = 0;
+    
+    ThreadBuffer& threadBuffer() {
+        // The registry keeps the buffer until the writer has drained it,
+        // even after its thread exits
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>();
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            m_buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+    
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_wake = true;
+        }
+        m_wakeCv.notify_one();
+    }
+    
+    void writerLoop() {
+        while (m_running.load()) {
+            bool suppressing = std::any_of(m_repeats.begin(), m_repeats.end(),
+                [](const auto& entry) { return entry.second.suppressed > 0; });
+            
+            // Only wake on a timer while a suppression summary is owed
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                if (suppressing) {
+                    m_wakeCv.wait_for(lock, std::chrono::milliseconds(LOG_REPEAT_WINDOW_MS),
+                        [this] { return m_wake; });
+                } else {
+                    m_wakeCv.wait(lock, [this] { return m_wake; });
+                }
+                m_wake = false;
+            }
+            drain();
+        }
+        
+        drain();
+    }
+    
+    void drain() {
+        m_pending.store(false);
+        
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            buffers = m_buffers;
+        }
+        
+        std::vector<LogRecord> batch;
+        for (const auto& buffer : buffers) {
+            uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+            uint32_t head = buffer->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                batch.push_back(buffer->records[tail % LOG_THREAD_BUFFER]);
+            }
+            buffer->tail.store(tail, std::memory_order_release);
+        }
+        
+        // Interleave threads in the order the lines were logged
+        std::sort(batch.begin(), batch.end(),
+            [](const LogRecord& a, const LogRecord& b) { return a.seq < b.seq; });
+        
+        auto now = std::chrono::steady_clock::now();
+        for (const auto& record : batch) {
+            write(record, now);
+        }
+        
+        flushRepeats(now);
+        reportDropped();
+        
+        std::cout.flush();
+        if (m_binaryLog.is_open()) {
+            m_binaryLog.flush();
+        }
+        
+        // Our copies would count as owners and keep every buffer alive
+        buffers.clear();
+        pruneBuffers();
+    }
+    
+    void write(const LogRecord& record, std::chrono::steady_clock::time_point now) {
+        std::string text(record.text, record.length);
+        
+        // The file keeps everything; only the console is rate limited
+        if (m_binaryLog.is_open()) {
+            m_binaryLog.write(reinterpret_cast<const char*>(&record.timeUs), sizeof(record.timeUs));
+            m_binaryLog.write(reinterpret_cast<const char*>(&record.level), sizeof(record.level));
+            m_binaryLog.write(reinterpret_cast<const char*>(&record.length), sizeof(record.length));
+            m_binaryLog.write(record.text, record.length);
+        }
+        
+        RepeatState& repeat = m_repeats[text];
+        if (now - repeat.windowStart > std::chrono::milliseconds(LOG_REPEAT_WINDOW_MS)) {
+            printSuppressed(text, repeat);
+            repeat.windowStart = now;
+            repeat.count = 0;
+        }
+        
+        if (++repeat.count > LOG_REPEAT_BURST) {
+            repeat.suppressed++;
+            return;
+        }
+        
+        std::cout << "\n[" << levelName(record.level) << "] " << text;
+    }
+    
+    void printSuppressed(const std::string& text, RepeatState& repeat) {
+        if (repeat.suppressed == 0) return;
+        
+        std::cout << "\n[WARN] Suppressed " << repeat.suppressed << " repeats of: " << text;
+        repeat.suppressed = 0;
+    }
+    
+    void flushRepeats(std::chrono::steady_clock::time_point now) {
+        for (auto it = m_repeats.begin(); it != m_repeats.end();) {
+            if (now - it->second.windowStart > std::chrono::milliseconds(LOG_REPEAT_WINDOW_MS)) {
+                printSuppressed(it->first, it->second);
+                it = m_repeats.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    void reportDropped() {
+        uint64_t dropped = m_dropped.load();
+        if (dropped == m_droppedReported) return;
+        
+        std::cout << "\n[WARN] " << (dropped - m_droppedReported) << " log messages dropped";
+        m_droppedReported = dropped;
+    }
+    
+    void pruneBuffers() {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        
+        // Buffers whose thread has exited (the registry holds the only
+        // reference) and that are fully drained
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(),
+            [](const std::shared_ptr<ThreadBuffer>& buffer) {
+                return buffer.use_count() == 1 &&
+                    buffer->head.load() == buffer->tail.load();
+            }), m_buffers.end());
+    }
+};
+    
+} // namespace
+
+void startLogger(LogLevel minLevel, const std::string& binaryLogPath) {
+    Logger::instance().start(minLevel, binaryLogPath);
+}
+
+void stopLogger() {
+    Logger::instance().stop();
+}
+
+void logMessage(LogLevel level, const std::string& message) {
+    Logger::instance().log(level, message);
+}
+
+uint64_t getLogMessagesDropped() {
+    return Logger::instance().dropped();
+}
+
+size_t getLogThreadBuffers() {
+    return Logger::instance().threadBuffers();
+}
+    
+} // namespace GameAway
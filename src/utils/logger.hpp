@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace GameAway {
+
+enum class LogLevel : uint8_t {
+    Debug,
+    Info,
+    Warn,
+    Error
+};
+
+// Asynchronous logging. Each thread appends to its own lock-free ring and a
+// background writer drains them to the console (and optionally a binary
+// log file), so network and hook threads never block on console output.
+// A full ring drops the message rather than waiting.
+
+// Start the writer; an empty path disables the binary log file
+void startLogger(LogLevel minLevel = LogLevel::Info, const std::string& binaryLogPath = "");
+
+// Flush everything queued and stop the writer
+void stopLogger();
+
+// Queue a message. Before startLogger() (or after stopLogger()) it is
+// written synchronously instead.
+void logMessage(LogLevel level, const std::string& message);
+
+inline void logDebug(const std::string& message) { logMessage(LogLevel::Debug, message); }
+inline void logInfo(const std::string& message) { logMessage(LogLevel::Info, message); }
+inline void logWarn(const std::string& message) { logMessage(LogLevel::Warn, message); }
+inline void logError(const std::string& message) { logMessage(LogLevel::Error, message); }
+
+// Messages lost because a thread's ring was full
+uint64_t getLogMessagesDropped();
+
+// Rings still registered; a thread's ring is freed once the thread has
+// exited and the writer has drained it
+size_t getLogThreadBuffers();
+
+} // namespace GameAway
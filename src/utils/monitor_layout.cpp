@@ -0,0 +1,142 @@
+#include "monitor_layout.hpp"
+#include <algorithm>
+#include <climits>
+
+namespace GameAway {
+
+static BOOL CALLBACK collectMonitor(HMONITOR monitor, HDC, LPRECT, LPARAM data) {
+    auto* monitors = reinterpret_cast<std::vector<std::pair<bool, MonitorRect>>*>(data);
+    
+    MONITORINFO info{};
+    info.cbSize = sizeof(info);
+    if (GetMonitorInfoW(monitor, &info)) {
+        MonitorRect rect{
+            static_cast<int>(info.rcMonitor.left),
+            static_cast<int>(info.rcMonitor.top),
+            static_cast<int>(info.rcMonitor.right - info.rcMonitor.left),
+            static_cast<int>(info.rcMonitor.bottom - info.rcMonitor.top)
+        };
+        monitors->emplace_back((info.dwFlags & MONITORINFOF_PRIMARY) != 0, rect);
+    }
+    
+    return TRUE;
+}
+
+std::vector<MonitorRect> queryMonitorLayout() {
+    std::vector<std::pair<bool, MonitorRect>> found;
+    EnumDisplayMonitors(nullptr, nullptr, collectMonitor, reinterpret_cast<LPARAM>(&found));
+    
+    // Stable order so both machines can pair monitors by index
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        if (a.first != b.first) return a.first;
+        if (a.second.left != b.second.left) return a.second.left < b.second.left;
+        return a.second.top < b.second.top;
+    });
+    
+    std::vector<MonitorRect> monitors;
+    for (const auto& entry : found) {
+        monitors.push_back(entry.second);
+    }
+    
+    // Fall back to the virtual screen metrics if enumeration failed
+    if (monitors.empty()) {
+        MonitorRect rect{
+            GetSystemMetrics(SM_XVIRTUALSCREEN),
+            GetSystemMetrics(SM_YVIRTUALSCREEN),
+            GetSystemMetrics(SM_CXVIRTUALSCREEN),
+            GetSystemMetrics(SM_CYVIRTUALSCREEN)
+        };
+        if (rect.width == 0) rect.width = GetSystemMetrics(SM_CXSCREEN);
+        if (rect.height == 0) rect.height = GetSystemMetrics(SM_CYSCREEN);
+        monitors.push_back(rect);
+    }
+    
+    return monitors;
+}
+
+MonitorRect boundingRect(const std::vector<MonitorRect>& monitors) {
+    if (monitors.empty()) return {0, 0, 0, 0};
+    
+    int left = INT_MAX, top = INT_MAX, right = INT_MIN, bottom = INT_MIN;
+    for (const auto& m : monitors) {
+        left = std::min(left, m.left);
+        top = std::min(top, m.top);
+        right = std::max(right, m.left + m.width);
+        bottom = std::max(bottom, m.top + m.height);
+    }
+    
+    return {left, top, right - left, bottom - top};
+}
+
+DisplayWatcher::~DisplayWatcher() {
+    stop();
+}
+
+bool DisplayWatcher::start(std::function<void()> onChange) {
+    if (m_running.load()) return false;
+    stop();
+    
+    m_onChange = std::move(onChange);
+    m_running.store(true);
+    m_thread = std::thread(&DisplayWatcher::messageLoop, this);
+    
+    return true;
+}
+
+void DisplayWatcher::stop() {
+    // The thread may already have given up on its own (no window), but it
+    // still has to be joined
+    m_running.store(false);
+    PostThreadMessage(m_threadId.load(), WM_QUIT, 0, 0);
+    
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_threadId.store(0);
+}
+
+void DisplayWatcher::messageLoop() {
+    static const wchar_t* CLASS_NAME = L"GameAwayDisplayWatcher";
+    
+    WNDCLASSEXW wc{};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = windowProc;
+    wc.hInstance = GetModuleHandleW(nullptr);
+    wc.lpszClassName = CLASS_NAME;
+    RegisterClassExW(&wc);  // Fails harmlessly if already registered
+    
+    // WM_DISPLAYCHANGE is only broadcast to top-level windows, so this
+    // cannot be a message-only window; it is simply never shown
+    HWND hwnd = CreateWindowExW(0, CLASS_NAME, L"", 0, 0, 0, 0, 0,
+                                nullptr, nullptr, wc.hInstance, nullptr);
+    if (!hwnd) {
+        m_running.store(false);
+        return;
+    }
+    SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+    
+    // Published once the window has given this thread a message queue, so
+    // stop() can post WM_QUIT to it; a stop() before this sees m_running
+    m_threadId.store(GetCurrentThreadId());
+    
+    MSG msg;
+    while (m_running.load() && GetMessage(&msg, nullptr, 0, 0) > 0) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+    
+    DestroyWindow(hwnd);
+}
+
+LRESULT CALLBACK DisplayWatcher::windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_DISPLAYCHANGE) {
+        auto* watcher = reinterpret_cast<DisplayWatcher*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+        if (watcher && watcher->m_onChange) {
+            watcher->m_onChange();
+        }
+    }
+    
+    return DefWindowProcW(hwnd, message, wParam, lParam);
+}
+
+} // namespace GameAway
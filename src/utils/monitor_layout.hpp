@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace GameAway {
+
+// One monitor in virtual-desktop physical pixels
+struct MonitorRect {
+    int left;
+    int top;
+    int width;
+    int height;
+};
+
+// Monitors of this machine, primary first, then left-to-right and top-to-bottom
+std::vector<MonitorRect> queryMonitorLayout();
+
+// Bounding rectangle of all monitors (the virtual desktop)
+MonitorRect boundingRect(const std::vector<MonitorRect>& monitors);
+
+// Watches for display topology changes (monitors added, removed, moved or
+// resized) using a hidden window on its own thread
+class DisplayWatcher {
+public:
+    DisplayWatcher() = default;
+    ~DisplayWatcher();
+    
+    // Start watching; the callback runs on the watcher thread
+    bool start(std::function<void()> onChange);
+    
+    // Stop watching
+    void stop();
+
+private:
+    std::function<void()> m_onChange;
+    std::atomic<bool> m_running{false};
+    std::atomic<DWORD> m_threadId{0};
+    std::thread m_thread;
+    
+    void messageLoop();
+    static LRESULT CALLBACK windowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
+};
+
+} // namespace GameAway
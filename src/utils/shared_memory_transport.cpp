@@ -0,0 +1,270 @@
+#include "shared_memory_transport.hpp"
+#include "config.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace GameAway {
+
+static constexpr uint32_t CHANNEL_MAGIC = 0x47414D31;  // "GAM1"
+
+static_assert((SHM_RING_SLOTS & (SHM_RING_SLOTS - 1)) == 0, "SHM_RING_SLOTS must be a power of two");
+
+// Slot kinds; open/close carry the connection lifecycle in-band. A message
+// longer than a slot goes out as FrameMore slots ending in one FrameData.
+enum FrameKind : uint32_t {
+    FrameData = 0,
+    FrameOpen = 1,
+    FrameClose = 2,
+    FrameMore = 3
+};
+
+// Indices only grow; the slot is index % SHM_RING_SLOTS. Head and tail sit
+// on separate cache lines so producer and consumer do not share one.
+struct SharedMemoryTransport::Ring {
+    struct Slot {
+        uint32_t kind;
+        uint32_t size;
+        char data[SHM_SLOT_SIZE];
+    };
+    
+    alignas(64) std::atomic<uint32_t> head;   // Written by the producer
+    alignas(64) std::atomic<uint32_t> tail;   // Written by the consumer
+    Slot slots[SHM_RING_SLOTS];
+};
+
+struct SharedMemoryTransport::Channel {
+    uint32_t magic;
+    Ring toServer;
+    Ring toClient;
+};
+
+static std::wstring objectName(uint16_t port, const wchar_t* suffix) {
+    return L"Local\\GameAway-" + std::to_wstring(port) + suffix;
+}
+
+SharedMemoryTransport::SharedMemoryTransport(Role role, uint16_t port)
+    : m_role(role), m_port(port) {
+}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+    stop();
+}
+
+void SharedMemoryTransport::setEventCallback(EventCallback callback) {
+    m_callback = std::move(callback);
+}
+
+void SharedMemoryTransport::emit(TransportEvent event, const std::string& data) {
+    if (m_callback) {
+        m_callback(event, data);
+    }
+}
+
+bool SharedMemoryTransport::attach(std::string& error) {
+    std::wstring mappingName = objectName(m_port, L"-channel");
+    std::wstring toServerName = objectName(m_port, L"-to-server");
+    std::wstring toClientName = objectName(m_port, L"-to-client");
+    std::wstring clientLockName = objectName(m_port, L"-client");
+    
+    if (m_role == Role::Server) {
+        m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                       0, static_cast<DWORD>(sizeof(Channel)), mappingName.c_str());
+        
+        // Another server already owns this port
+        if (m_mapping && GetLastError() == ERROR_ALREADY_EXISTS) {
+            CloseHandle(m_mapping);
+            m_mapping = nullptr;
+        }
+        error = "Shared memory channel already in use";
+    } else {
+        // The rings have one producer per side. The mutex is only used for
+        // its name: it exists while some client holds it, and the system
+        // closes it if that client dies, so a crashed client never locks us out.
+        m_clientLock = CreateMutexW(nullptr, FALSE, clientLockName.c_str());
+        if (!m_clientLock || GetLastError() == ERROR_ALREADY_EXISTS) {
+            error = "Another local client is already connected";
+            detach();
+            return false;
+        }
+        
+        m_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+        error = "No local server is running";
+    }
+    if (!m_mapping) {
+        detach();
+        return false;
+    }
+    
+    m_channel = static_cast<Channel*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Channel)));
+    if (!m_channel) {
+        detach();
+        return false;
+    }
+    
+    if (m_role == Role::Server) {
+        // Fresh sections are zero-filled, so both rings start empty
+        m_channel->magic = CHANNEL_MAGIC;
+        m_rxEvent = CreateEventW(nullptr, FALSE, FALSE, toServerName.c_str());
+        m_txEvent = CreateEventW(nullptr, FALSE, FALSE, toClientName.c_str());
+        m_rx = &m_channel->toServer;
+        m_tx = &m_channel->toClient;
+    } else {
+        if (m_channel->magic != CHANNEL_MAGIC) {
+            detach();
+            return false;
+        }
+        m_rxEvent = OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, toClientName.c_str());
+        m_txEvent = OpenEventW(EVENT_MODIFY_STATE | SYNCHRONIZE, FALSE, toServerName.c_str());
+        m_rx = &m_channel->toClient;
+        m_tx = &m_channel->toServer;
+    }
+    
+    if (!m_rxEvent || !m_txEvent) {
+        detach();
+        return false;
+    }
+    
+    m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    return true;
+}
+
+void SharedMemoryTransport::detach() {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    
+    m_rx = nullptr;
+    m_tx = nullptr;
+    
+    if (m_channel) {
+        UnmapViewOfFile(m_channel);
+        m_channel = nullptr;
+    }
+    for (HANDLE* handle : {&m_mapping, &m_clientLock, &m_rxEvent, &m_txEvent, &m_stopEvent}) {
+        if (*handle) {
+            CloseHandle(*handle);
+            *handle = nullptr;
+        }
+    }
+}
+
+void SharedMemoryTransport::start() {
+    if (m_thread.joinable()) return;
+    
+    std::string error;
+    if (!attach(error)) {
+        emit(TransportEvent::Error, error);
+        return;
+    }
+    m_partial.clear();
+    
+    if (m_role == Role::Client) {
+        // Anything left over was meant for a previous client
+        m_rx->tail.store(m_rx->head.load(std::memory_order_acquire), std::memory_order_release);
+        
+        push(FrameOpen, std::string());
+        m_open.store(true);
+    }
+    
+    m_thread = std::thread(&SharedMemoryTransport::receiveLoop, this);
+}
+
+void SharedMemoryTransport::stop() {
+    if (!m_thread.joinable()) return;
+    
+    if (m_open.exchange(false)) {
+        push(FrameClose, std::string());
+    }
+    
+    SetEvent(m_stopEvent);
+    m_thread.join();
+    detach();
+}
+
+bool SharedMemoryTransport::send(const std::string& message) {
+    return push(FrameData, message);
+}
+
+void SharedMemoryTransport::close() {
+    if (m_open.exchange(false)) {
+        push(FrameClose, std::string());
+        emit(TransportEvent::Close);
+    }
+}
+
+size_t SharedMemoryTransport::bufferedAmount() const {
+    // Held so the view cannot be unmapped under us
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    if (!m_tx) return 0;
+    
+    uint32_t queued = m_tx->head.load(std::memory_order_relaxed) - m_tx->tail.load(std::memory_order_relaxed);
+    return static_cast<size_t>(queued) * SHM_SLOT_SIZE;
+}
+
+bool SharedMemoryTransport::push(uint32_t kind, const std::string& data) {
+    std::lock_guard<std::mutex> lock(m_sendMutex);
+    
+    if (!m_tx) return false;
+    
+    uint32_t head = m_tx->head.load(std::memory_order_relaxed);
+    uint32_t tail = m_tx->tail.load(std::memory_order_acquire);
+    
+    // Short of room: the reader is stalled, so behave like a congested socket.
+    // Nothing is written, so the reader never sees half a message.
+    size_t slots = std::max<size_t>(1, (data.size() + SHM_SLOT_SIZE - 1) / SHM_SLOT_SIZE);
+    if (slots > SHM_RING_SLOTS - (head - tail)) return false;
+    
+    for (size_t i = 0; i < slots; ++i) {
+        size_t offset = i * SHM_SLOT_SIZE;
+        size_t size = std::min<size_t>(SHM_SLOT_SIZE, data.size() - offset);
+        
+        Ring::Slot& slot = m_tx->slots[(head + i) % SHM_RING_SLOTS];
+        slot.kind = i + 1 < slots ? FrameMore : kind;
+        slot.size = static_cast<uint32_t>(size);
+        std::memcpy(slot.data, data.data() + offset, size);
+    }
+    
+    // One release for the whole message
+    m_tx->head.store(head + static_cast<uint32_t>(slots), std::memory_order_release);
+    SetEvent(m_txEvent);
+    return true;
+}
+
+void SharedMemoryTransport::receiveLoop() {
+    if (m_role == Role::Client) {
+        emit(TransportEvent::Open);
+    }
+    
+    HANDLE handles[2] = {m_stopEvent, m_rxEvent};
+    
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+        // Drain everything published so far; the event is auto-reset, so a
+        // frame pushed after the last check re-signals it
+        uint32_t tail = m_rx->tail.load(std::memory_order_relaxed);
+        while (tail != m_rx->head.load(std::memory_order_acquire)) {
+            const Ring::Slot& slot = m_rx->slots[tail % SHM_RING_SLOTS];
+            uint32_t kind = slot.kind;
+            m_partial.append(slot.data, std::min<uint32_t>(slot.size, SHM_SLOT_SIZE));
+            
+            m_rx->tail.store(++tail, std::memory_order_release);
+            
+            if (kind == FrameMore) continue;
+            std::string data;
+            data.swap(m_partial);
+            
+            if (kind == FrameOpen) {
+                // A client that vanished without closing is replaced by the new one
+                if (m_open.exchange(true)) {
+                    emit(TransportEvent::Close);
+                }
+                emit(TransportEvent::Open);
+            } else if (kind == FrameClose) {
+                if (m_open.exchange(false)) {
+                    emit(TransportEvent::Close);
+                }
+            } else if (m_open.load()) {
+                emit(TransportEvent::Message, data);
+            }
+        }
+    }
+}
+
+} // namespace GameAway
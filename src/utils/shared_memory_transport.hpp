@@ -0,0 +1,66 @@
+#pragma once
+
+#include "transport.hpp"
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace GameAway {
+
+// Same-host transport: a shared memory section holds one single-producer,
+// single-consumer ring per direction, and named events wake the reader.
+// The server side creates the section; one client at a time attaches to it,
+// and a second one fails to start rather than share the rings.
+class SharedMemoryTransport : public Transport {
+public:
+    enum class Role {
+        Server,
+        Client
+    };
+    
+    SharedMemoryTransport(Role role, uint16_t port);
+    ~SharedMemoryTransport() override;
+    
+    void setEventCallback(EventCallback callback) override;
+    void start() override;
+    void stop() override;
+    bool send(const std::string& message) override;
+    void close() override;
+    size_t bufferedAmount() const override;
+
+private:
+    struct Ring;
+    struct Channel;
+    
+    Role m_role;
+    uint16_t m_port;
+    EventCallback m_callback;
+    
+    HANDLE m_mapping = nullptr;
+    HANDLE m_clientLock = nullptr;    // Client only: exists while a client is attached
+    Channel* m_channel = nullptr;
+    Ring* m_rx = nullptr;
+    Ring* m_tx = nullptr;
+    HANDLE m_rxEvent = nullptr;
+    HANDLE m_txEvent = nullptr;
+    HANDLE m_stopEvent = nullptr;
+    std::thread m_thread;
+    
+    mutable std::mutex m_sendMutex;   // Keeps our side a single producer
+    std::atomic<bool> m_open{false};
+    std::string m_partial;            // Receive thread: a message still arriving in slots
+    
+    bool attach(std::string& error);
+    void detach();
+    void receiveLoop();
+    
+    // All of a message's slots or none; false if the ring lacks room
+    bool push(uint32_t kind, const std::string& data);
+    void emit(TransportEvent event, const std::string& data = std::string());
+};
+
+} // namespace GameAway
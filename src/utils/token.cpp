@@ -1,10 +1,14 @@
 #include "token.hpp"
 #include "config.hpp"
+#include "crypto.hpp"
 
 #include <Windows.h>
 #include <bcrypt.h>
 #include <random>
 #include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 
 #pragma comment(lib, "bcrypt.lib")
 
@@ -55,4 +59,61 @@ std::string getPcName() {
     return "Unknown";
 }
 
+std::string getDataPath(const std::string& fileName) {
+    std::filesystem::path dir = ".";
+    
+    if (const char* localAppData = std::getenv("LOCALAPPDATA")) {
+        dir = std::filesystem::path(localAppData) / "GameAway";
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec) dir = ".";
+    }
+    
+    return (dir / fileName).string();
+}
+
+std::string getClientId() {
+    static const std::string clientId = [] {
+        std::string path = getDataPath(CLIENT_ID_FILE);
+        
+        std::string id;
+        std::ifstream in(path);
+        if (in) std::getline(in, id);
+        
+        if (id.length() != CLIENT_ID_LENGTH) {
+            id = generateToken(CLIENT_ID_LENGTH);
+            std::ofstream out(path, std::ios::trunc);
+            out << id << "\n";
+        }
+        
+        return id;
+    }();
+    
+    return clientId;
+}
+
+uintptr_t getInjectionMarker() {
+    static const uintptr_t marker = [] {
+        // FNV-1a over the installation ID
+        uint32_t hash = 2166136261u;
+        for (char c : getClientId()) {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 16777619u;
+        }
+        
+        // 'GA' in the high half keeps it clear of small values other tools use
+        return static_cast<uintptr_t>(0x47410000u | (hash & 0xFFFFu));
+    }();
+    
+    return marker;
+}
+
+std::string getPairingId(const std::string& token) {
+    // HMAC under a key stretched from the token by its own PBKDF2 run: the
+    // ID travels in the clear, so each guess at the token must pay for the
+    // full key derivation
+    Crypto pairingKey(token, KeyPurpose::Pairing);
+    return pairingKey.sign("GameAway-pair");
+}
+
 } // namespace GameAway
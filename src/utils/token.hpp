@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 namespace GameAway {
 
@@ -10,4 +11,19 @@ std::string generateToken(size_t length = 6);
 // Get the computer's hostname
 std::string getPcName();
 
+// Path of a file in the per-user GameAway data directory (%LOCALAPPDATA%\\GameAway)
+std::string getDataPath(const std::string& fileName);
+
+// Persistent random identifier for this installation, created on first use
+std::string getClientId();
+
+// Tag stored in dwExtraInfo of every event we inject, derived from the
+// installation ID, so our own hooks can recognise and skip replayed input
+uintptr_t getInjectionMarker();
+
+// Relay pairing ID for a connection token, so both peers find each other
+// without sending the token to the relay. Runs a full PBKDF2 derivation, so
+// compute it once per token.
+std::string getPairingId(const std::string& token);
+
 } // namespace GameAway
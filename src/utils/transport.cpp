@@ -0,0 +1,52 @@
+#include "transport.hpp"
+#include <ixwebsocket/IXWebSocket.h>
+
+namespace GameAway {
+
+WebSocketTransport::WebSocketTransport(std::shared_ptr<ix::WebSocket> socket)
+    : m_socket(std::move(socket)) {
+}
+
+void WebSocketTransport::setEventCallback(EventCallback callback) {
+    m_socket->setOnMessageCallback([callback](const ix::WebSocketMessagePtr& msg) {
+        switch (msg->type) {
+            case ix::WebSocketMessageType::Open:
+                callback(TransportEvent::Open, std::string());
+                break;
+            case ix::WebSocketMessageType::Message:
+                callback(TransportEvent::Message, msg->str);
+                break;
+            case ix::WebSocketMessageType::Close:
+                callback(TransportEvent::Close, std::string());
+                break;
+            case ix::WebSocketMessageType::Error:
+                callback(TransportEvent::Error, msg->errorInfo.reason);
+                break;
+            default:
+                // Ping/pong and fragments are handled inside IXWebSocket
+                break;
+        }
+    });
+}
+
+void WebSocketTransport::start() {
+    m_socket->start();
+}
+
+void WebSocketTransport::stop() {
+    m_socket->stop();
+}
+
+bool WebSocketTransport::send(const std::string& message) {
+    return m_socket->send(message).success;
+}
+
+void WebSocketTransport::close() {
+    m_socket->close();
+}
+
+size_t WebSocketTransport::bufferedAmount() const {
+    return m_socket->bufferedAmount();
+}
+    
+} // namespace GameAway
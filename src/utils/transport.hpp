@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+// Only WebSocketTransport needs the socket type, and keeping its header out
+// lets the transport-agnostic code build without IXWebSocket
+namespace ix {
+class WebSocket;
+}
+
+namespace GameAway {
+
+// What a transport reports to its owner
+enum class TransportEvent {
+    Open,       // Link is up and can send
+    Message,    // data is the received message
+    Close,      // Link is down
+    Error       // data is the reason; the link is down
+};
+
+// Message link between client and server. Client and Server only talk to
+// this, so the wire (WebSocket, shared memory) can be chosen per connection.
+class Transport {
+public:
+    using EventCallback = std::function<void(TransportEvent event, const std::string& data)>;
+    
+    virtual ~Transport() = default;
+    
+    // Set before start(); runs on the transport's own thread
+    virtual void setEventCallback(EventCallback callback) = 0;
+    
+    // Connect, or reconnect after stop()
+    virtual void start() = 0;
+    
+    // Disconnect and wait for the transport thread to finish
+    virtual void stop() = 0;
+    
+    // Queue a message (thread-safe); false if it could not be queued
+    virtual bool send(const std::string& message) = 0;
+    
+    // Ask the far end to close; a Close event follows
+    virtual void close() = 0;
+    
+    // Bytes queued but not yet handed to the far end
+    virtual size_t bufferedAmount() const = 0;
+};
+
+// Transport over an IXWebSocket socket, either one we connect ourselves or
+// one accepted by an ix::WebSocketServer (which then owns its callback)
+class WebSocketTransport : public Transport {
+public:
+    explicit WebSocketTransport(std::shared_ptr<ix::WebSocket> socket);
+    
+    void setEventCallback(EventCallback callback) override;
+    void start() override;
+    void stop() override;
+    bool send(const std::string& message) override;
+    void close() override;
+    size_t bufferedAmount() const override;
+
+private:
+    std::shared_ptr<ix::WebSocket> m_socket;
+};
+
+} // namespace GameAway
@@ -0,0 +1,184 @@
+// Scenarios for ImpairedTransport on a virtual clock, so each one plays out
+// the same on every run and in no time. Exits non-zero if any check fails.
+
+#include "utils/impaired_transport.hpp"
+#include <algorithm>
+#include <bitset>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace GameAway;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        g_failures++;
+    }
+}
+
+// Stands in for the real link: keeps what was sent and when it arrived
+class RecordingTransport : public Transport {
+public:
+    struct Arrival {
+        std::string message;
+        int64_t atUs;
+    };
+    
+    explicit RecordingTransport(std::shared_ptr<VirtualClock> clock) : m_clock(std::move(clock)) {
+    }
+    
+    void setEventCallback(EventCallback callback) override { m_callback = std::move(callback); }
+    void start() override {}
+    void stop() override {}
+    
+    bool send(const std::string& message) override {
+        auto now = std::chrono::duration_cast<std::chrono::microseconds>(m_clock->now().time_since_epoch());
+        arrivals.push_back({message, now.count()});
+        return true;
+    }
+    
+    void close() override {}
+    size_t bufferedAmount() const override { return 0; }
+    
+    std::vector<Arrival> arrivals;
+
+private:
+    std::shared_ptr<VirtualClock> m_clock;
+    EventCallback m_callback;
+};
+
+struct Link {
+    std::shared_ptr<VirtualClock> clock = std::make_shared<VirtualClock>();
+    RecordingTransport* wire = nullptr;
+    std::unique_ptr<ImpairedTransport> impaired;
+    
+    explicit Link(const std::string& settings) {
+        ImpairmentProfile profile;
+        std::string error;
+        check(ImpairmentProfile::parse(settings, profile, error), "profile parses: " + settings + " " + error);
+        
+        auto recording = std::make_unique<RecordingTransport>(clock);
+        wire = recording.get();
+        impaired = std::make_unique<ImpairedTransport>(std::move(recording), profile, clock);
+        impaired->start();
+    }
+    
+    void advance(std::chrono::microseconds step) {
+        clock->advance(step);
+        impaired->deliverDue();
+    }
+};
+
+// Key presses and releases, one every 10 ms, played until the link is idle.
+// Returns how often the far end saw a key stay down: pressed again before
+// its release came, or still down once everything has arrived.
+int playKeys(Link& link, int presses) {
+    for (int i = 0; i < presses; i++) {
+        int key = i % 16;
+        link.impaired->send("d" + std::to_string(key));
+        link.advance(std::chrono::milliseconds(5));
+        link.impaired->send("u" + std::to_string(key));
+        link.advance(std::chrono::milliseconds(5));
+    }
+    link.advance(std::chrono::seconds(60));
+    
+    std::bitset<16> held;
+    int stuck = 0;
+    for (const auto& arrival : link.wire->arrivals) {
+        int key = std::stoi(arrival.message.substr(1));
+        bool down = arrival.message[0] == 'd';
+        if (down && held.test(key)) {
+            stuck++;
+        }
+        held.set(key, down);
+    }
+    return stuck + static_cast<int>(held.count());
+}
+
+void reliableLossStallsInOrder() {
+    Link link("delay=20 loss=0.05 burst=3 seed=11");
+    int stuck = playKeys(link, 2000);
+    
+    ImpairedTransport::Stats stats = link.impaired->getStats();
+    check(stats.retransmitted > 0, "reliable: some messages were lost and resent");
+    check(stats.dropped == 0, "reliable: nothing is dropped");
+    check(link.wire->arrivals.size() == 4000, "reliable: every message arrives once");
+    check(stuck == 0, "reliable: no key is left stuck down");
+    
+    // In order, and a loss holds up what follows by at least the timeout
+    bool ordered = true;
+    int64_t worstUs = 0;
+    for (size_t i = 0; i < link.wire->arrivals.size(); i++) {
+        const auto& arrival = link.wire->arrivals[i];
+        std::string expected = std::string(i % 2 ? "u" : "d") + std::to_string((i / 2) % 16);
+        ordered = ordered && arrival.message == expected;
+        
+        int64_t sentUs = static_cast<int64_t>(i) * 5000;
+        worstUs = std::max(worstUs, arrival.atUs - sentUs);
+    }
+    check(ordered, "reliable: messages arrive in the order sent");
+    check(worstUs >= 320000, "reliable: a loss stalls delivery by the 300 ms timeout");
+}
+
+void unreliableLossCanStickKeys() {
+    Link link("delay=20 loss=0.05 burst=3 mode=unreliable seed=11");
+    int stuck = playKeys(link, 2000);
+    
+    ImpairedTransport::Stats stats = link.impaired->getStats();
+    check(stats.dropped > 0 && stats.retransmitted == 0, "unreliable: losses are dropped");
+    check(link.wire->arrivals.size() == 4000 - stats.dropped, "unreliable: the rest arrive");
+    check(stuck > 0, "unreliable: a lost release leaves a key down");
+}
+
+void reorderNeedsUnreliable() {
+    ImpairmentProfile profile;
+    std::string error;
+    check(!ImpairmentProfile::parse("reorder=0.01", profile, error), "reliable: reorder is refused");
+    check(ImpairmentProfile::parse("reorder=0.01 mode=unreliable", profile, error), "unreliable: reorder is accepted");
+}
+
+// 100-byte messages at a steady rate for one second on a 1000 kbit/s link,
+// where each takes 0.8 ms on the wire; returns what is still queued
+size_t queuedAfterSecond(Link& link, std::chrono::microseconds interval) {
+    const std::string message(100, 'm');
+    for (auto elapsed = std::chrono::microseconds(0); elapsed < std::chrono::seconds(1); elapsed += interval) {
+        link.impaired->send(message);
+        link.advance(interval);
+    }
+    return link.impaired->getStats().queued;
+}
+
+void bandwidthCapQueues() {
+    // 1.6 Mbit/s offered: 2000 sent, about 1250 through, the rest waiting
+    Link over("bandwidth=1000");
+    size_t backlog = queuedAfterSecond(over, std::chrono::microseconds(500));
+    check(backlog >= 700 && backlog <= 800, "over the cap: the queue grows by the excess");
+    check(over.impaired->bufferedAmount() == backlog * 100, "over the cap: the backlog shows as buffered bytes");
+    
+    // 0.4 Mbit/s offered: each message is gone before the next
+    Link under("bandwidth=1000");
+    queuedAfterSecond(under, std::chrono::microseconds(2000));
+    check(under.impaired->getStats().peakQueued <= 1, "under the cap: nothing builds up");
+}
+
+} // namespace
+
+int main() {
+    reliableLossStallsInOrder();
+    unreliableLossCanStickKeys();
+    reorderNeedsUnreliable();
+    bandwidthCapQueues();
+    
+    if (g_failures > 0) {
+        std::cerr << g_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All impairment scenarios passed" << std::endl;
+    return 0;
+}
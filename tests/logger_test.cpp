@@ -0,0 +1,68 @@
+// Checks that the asynchronous logger frees the ring of a thread that has
+// exited, so a flood of short-lived connection threads cannot grow it.
+// Exits non-zero if any check fails.
+
+#include "utils/logger.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace GameAway;
+
+namespace {
+
+int g_failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        g_failures++;
+    }
+}
+
+// Logs from the calling thread until only 'expected' rings are left, which
+// each drain gets a chance to prune; false if that takes over two seconds
+bool waitForBuffers(size_t expected) {
+    for (int attempt = 0; attempt < 200; attempt++) {
+        logInfo("Waiting for the writer");
+        if (getLogThreadBuffers() == expected) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+void exitedThreadsAreFreed() {
+    startLogger(LogLevel::Info);
+    
+    logInfo("Main thread ring");
+    check(waitForBuffers(1), "the main thread has one ring");
+    
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 100; i++) {
+        threads.emplace_back([i]() {
+            logInfo("Refused connection from 10.0.0." + std::to_string(i));
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    check(waitForBuffers(1), "the rings of 100 exited threads are freed");
+    
+    stopLogger();
+}
+    
+} // namespace
+
+int main() {
+    exitedThreadsAreFreed();
+    
+    if (g_failures > 0) {
+        std::cerr << g_failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "\nLogger buffers are freed" << std::endl;
+    return 0;
+}